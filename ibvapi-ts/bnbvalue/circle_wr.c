@@ -12,6 +12,9 @@
  * @param use_send_wr        Use @b ibv_post_send() or @b ibv_post_recv()
  *                           function
  * @param circle_len         Length of WR list loop
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
  *
  * @author Yurij Plotnikov <Yurij.Plotnikov@oktetlabs.ru>
  *
@@ -29,6 +32,7 @@ int
 main(int argc, char *argv[])
 {
     rcf_rpc_server         *pco_iut = NULL;
+    rcf_rpc_server         *pco_iut_orig = NULL;
 
     struct rpc_ibv_context *iut_context = NULL;
 
@@ -57,11 +61,13 @@ main(int argc, char *argv[])
     te_bool                 use_send_wr;
     int                     i;
     int                     circle_len;
+    ibvts_buf_backing       buf_backing;
 
     TEST_START;
     TEST_GET_IBV_PCO(pco_iut);
     TEST_GET_BOOL_PARAM(use_send_wr);
     TEST_GET_INT_PARAM(circle_len);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
 
     memset(&attr, 0, sizeof(attr));
     memset(&qp_attr, 0, sizeof(qp_attr));
@@ -201,6 +207,7 @@ main(int argc, char *argv[])
 
 cleanup:
     rpc_free(pco_iut, iut_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
 
     TEST_END;
 }
@@ -54,6 +54,9 @@
 /** PAGE size to be used in test */
 #define TEST_PAGE_SIZE 4096
 
+/** Timeout of waiting for completions in milliseconds */
+#define TEST_COMPL_TIMEOUT 5000
+
 /**
  * Open IB library on specified PCO to get IB Verbs from it
  *
@@ -83,6 +86,86 @@
         OPEN_IBV_LIB(_rpcs, "/usr/lib64/librdmacm.so");  \
     } while (0)
 
+/** Values of buffers backing parameter */
+#define BUF_BACKING_MAPPING_LIST \
+    { "4k", IBVTS_BUF_BACKING_4K },           \
+    { "thp", IBVTS_BUF_BACKING_THP },         \
+    { "huge_2m", IBVTS_BUF_BACKING_HUGE_2M }, \
+    { "huge_1g", IBVTS_BUF_BACKING_HUGE_1G }
+
+/**
+ * Get value of buffers backing parameter.
+ *
+ * @param _var  Variable of type ibvts_buf_backing with the same name as
+ *              the parameter
+ */
+#define TEST_GET_BUF_BACKING_PARAM(_var) \
+    TEST_GET_ENUM_PARAM(_var, BUF_BACKING_MAPPING_LIST)
+
+/**
+ * Create RPC server in a new process allocating buffers with requested
+ * backing (see ibvts_buf_backing_fork()) and open IBV library in it.
+ * All verbs objects using the buffers should be created in the new RPC
+ * server, it should be destroyed by the test.
+ *
+ * @param _rpcs     RPC server to fork from
+ * @param _backing  Buffers backing
+ * @param _name     Name of the new RPC server
+ * @param _new      Variable for the new RPC server handler
+ */
+#define CREATE_BUF_BACKING_PCO(_rpcs, _backing, _name, _new) \
+    do {                                                           \
+        CHECK_RC(ibvts_buf_backing_fork(_rpcs, _backing, _name,    \
+                                        &(_new)));                 \
+        OPEN_IBV_LIB(_new, "/usr/lib64/librdmacm.so");             \
+    } while (0)
+
+/**
+ * Get buffers backing parameter and, unless it is @c 4k, replace RPC
+ * server with one created by CREATE_BUF_BACKING_PCO(), so that buffers
+ * and verbs objects the test creates on it are backed by the requested
+ * pages. The parameter is optional, @c 4k is used if a run does not
+ * specify it. It should be used after all parameters referring to the
+ * RPC server are got. The new RPC server is destroyed by
+ * CLEANUP_BUF_BACKING_PCO().
+ *
+ * @param _rpcs     Variable with RPC server handler
+ * @param _backing  Variable of type ibvts_buf_backing with the same name
+ *                  as the parameter
+ * @param _orig     Variable for the original RPC server handler,
+ *                  initialized by @c NULL
+ */
+#define TEST_GET_BUF_BACKING_PCO(_rpcs, _backing, _orig) \
+    do {                                                           \
+        (_backing) = IBVTS_BUF_BACKING_4K;                         \
+        if (TEST_HAS_PARAM(_backing))                              \
+        {                                                          \
+            TEST_GET_BUF_BACKING_PARAM(_backing);                  \
+        }                                                          \
+        if ((_backing) != IBVTS_BUF_BACKING_4K)                    \
+        {                                                          \
+            (_orig) = (_rpcs);                                     \
+            CREATE_BUF_BACKING_PCO(_orig, _backing, #_rpcs "_buf", \
+                                   _rpcs);                         \
+        }                                                          \
+    } while (0)
+
+/**
+ * Destroy RPC server created by TEST_GET_BUF_BACKING_PCO() and restore
+ * the original one. It should be used at the end of cleanup.
+ *
+ * @param _rpcs     Variable with RPC server handler
+ * @param _orig     Variable with the original RPC server handler
+ */
+#define CLEANUP_BUF_BACKING_PCO(_rpcs, _orig) \
+    do {                                                        \
+        if ((_orig) != NULL && (_rpcs) != (_orig))              \
+        {                                                       \
+            CLEANUP_CHECK_RC(rcf_rpc_server_destroy(_rpcs));    \
+            (_rpcs) = (_orig);                                  \
+        }                                                       \
+    } while (0)
+
 /** Nonexistent QP type */
 #define RPC_INCORRECT_QP_TYPE 30
 
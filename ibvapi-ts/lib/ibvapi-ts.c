@@ -12,7 +12,15 @@
 /** User name of InfiniBand Verbs API test suite library */
 #define TE_LGR_USER     "Library"
 
+#include <sys/time.h>
+#include <unistd.h>
+
+/* FIXME avoid usage of tested API defines on TEN side */
+#include <infiniband/verbs.h>
+
 #include "ibvapi-ts.h"
+#include "te_string.h"
+#include "tapi_mem.h"
 
 /* See description in ibvapi-ts.h */
 int
@@ -74,6 +82,288 @@ ibvts_create_raw_udp_dgm(const struct sockaddr *src_laddr,
     return (sizeof(te_eth_ip_udp_hdr) + payload_len);
 }
 
+/* See description in ibvapi-ts.h */
+uint32_t
+ibvts_csum_partial(const void *data, size_t len, uint32_t sum)
+{
+    const uint8_t  *p = data;
+    uint64_t        acc = sum;
+    uint64_t        w64;
+    uint32_t        w32;
+    uint16_t        w16;
+
+/* Add a word to the accumulator with end-around carry */
+#define IBVTS_CSUM_ADD(_w) \
+    do {                        \
+        acc += (_w);            \
+        if (acc < (_w))         \
+            acc++;              \
+    } while (0)
+
+    for (; len >= sizeof(w64); p += sizeof(w64), len -= sizeof(w64))
+    {
+        memcpy(&w64, p, sizeof(w64));
+        IBVTS_CSUM_ADD(w64);
+    }
+    if (len >= sizeof(w32))
+    {
+        memcpy(&w32, p, sizeof(w32));
+        IBVTS_CSUM_ADD(w32);
+        p += sizeof(w32);
+        len -= sizeof(w32);
+    }
+    if (len >= sizeof(w16))
+    {
+        memcpy(&w16, p, sizeof(w16));
+        IBVTS_CSUM_ADD(w16);
+        p += sizeof(w16);
+        len -= sizeof(w16);
+    }
+    if (len > 0)
+    {
+        /* The last odd byte is padded by zero byte */
+        w16 = 0;
+        memcpy(&w16, p, 1);
+        IBVTS_CSUM_ADD(w16);
+    }
+#undef IBVTS_CSUM_ADD
+
+    acc = (acc & 0xffffffff) + (acc >> 32);
+    acc = (acc & 0xffffffff) + (acc >> 32);
+
+    return (uint32_t)acc;
+}
+
+/* See description in ibvapi-ts.h */
+uint16_t
+ibvts_csum_fold(uint32_t sum)
+{
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+
+    return (uint16_t)~sum;
+}
+
+/* See description in ibvapi-ts.h */
+uint16_t
+ibvts_ip_csum(const struct iphdr *iphdr)
+{
+    return ibvts_csum_fold(ibvts_csum_partial(iphdr, iphdr->ihl * 4, 0));
+}
+
+/* See description in ibvapi-ts.h */
+int
+ibvts_create_raw_udp_burst(const struct sockaddr *src_laddr,
+                           const struct sockaddr *dst_laddr,
+                           const struct sockaddr *src_addr,
+                           const struct sockaddr *dst_addr,
+                           uint16_t first_seq, te_bool multicast,
+                           char **bufs, uint16_t payload_len, int num,
+                           uint8_t *burst)
+{
+    te_eth_ip_udp_hdr   tmpl;
+    te_eth_ip_udp_hdr  *packet;
+    int                 pkt_len;
+    int                 i;
+
+    pkt_len = sizeof(te_eth_ip_udp_hdr) + payload_len;
+    if (num <= 0)
+        return pkt_len;
+
+    /* Make headers template without payload */
+    ibvts_create_raw_udp_dgm(src_laddr, dst_laddr, src_addr, dst_addr,
+                             first_seq, multicast, bufs[0], 0,
+                             (uint8_t *)&tmpl);
+    tmpl.iphdr.tot_len = htons(sizeof(struct iphdr) +
+                               sizeof(struct udphdr) + payload_len);
+    tmpl.udphdr.len = htons(sizeof(struct udphdr) + payload_len);
+
+    for (i = 0; i < num; i++)
+    {
+        packet = (te_eth_ip_udp_hdr *)&burst[i * pkt_len];
+        memcpy(packet, &tmpl, sizeof(tmpl));
+        packet->iphdr.id = (uint16_t)(first_seq + i);
+        memcpy(&burst[i * pkt_len + sizeof(tmpl)], bufs[i], payload_len);
+    }
+
+    return pkt_len;
+}
+
+/* See description in ibvapi-ts.h */
+size_t
+ibvts_upload_burst(rcf_rpc_server *rpcs, const uint8_t *burst,
+                   const struct rpc_ibv_send_wr *wr, int num)
+{
+    const struct rpc_ibv_sge   *sge;
+    const struct rpc_ibv_sge   *run = NULL;
+    size_t                      run_len = 0;
+    size_t                      total_len = 0;
+    int                         i;
+    int                         j;
+
+    for (i = 0; i < num; i++)
+    {
+        for (j = 0; j < wr[i].num_sge; j++)
+        {
+            sge = &wr[i].sg_list[j];
+            if (run != NULL && sge->addr == run->addr &&
+                sge->offset == run->offset + run_len)
+            {
+                run_len += sge->length;
+                continue;
+            }
+
+            if (run != NULL && run_len > 0)
+            {
+                rpc_set_buf_gen(rpcs, &burst[total_len], run_len,
+                                run->addr, run->offset);
+            }
+            total_len += run_len;
+            run = sge;
+            run_len = sge->length;
+        }
+    }
+    if (run != NULL && run_len > 0)
+        rpc_set_buf_gen(rpcs, &burst[total_len], run_len, run->addr,
+                        run->offset);
+    total_len += run_len;
+
+    return total_len;
+}
+
+/**
+ * Get part of SGE which overlaps range of data referred by SGE list.
+ *
+ * @param sge_len   Length of SGE
+ * @param sge_off   Offset of SGE in data referred by SGE list
+ * @param off       Offset of the range
+ * @param len       Length of the range
+ * @param part_off  Offset of the part in SGE (OUT)
+ *
+ * @return Length of the part.
+ */
+static size_t
+sge_part(size_t sge_len, size_t sge_off, size_t off, size_t len,
+         size_t *part_off)
+{
+    size_t start = MAX(sge_off, off);
+    size_t end = MIN(sge_off + sge_len, off + len);
+
+    if (start >= end)
+        return 0;
+
+    *part_off = start - sge_off;
+    return end - start;
+}
+
+/** Range of memory on RPC server holding data referred by SGE list */
+typedef struct sge_range {
+    rpc_ptr addr;   /**< Memory block */
+    size_t  off;    /**< Offset of the range in @a addr */
+    size_t  len;    /**< Length of the range */
+    size_t  pos;    /**< Offset of the range in the requested data */
+} sge_range;
+
+/**
+ * Get next range of memory holding the requested part of data referred
+ * by SGE list. Parts of adjacent SGEs referring to adjacent memory are
+ * merged to one range.
+ *
+ * @param sge       SGE list
+ * @param sge_num   Number of entries in @p sge
+ * @param off       Offset of the requested part of data
+ * @param len       Length of the requested part of data
+ * @param idx       Index of SGE to start from (IN/OUT)
+ * @param sge_off   Offset of SGE @p idx in data (IN/OUT)
+ * @param range     Range (OUT)
+ *
+ * @return @c TRUE if the range is got.
+ */
+static te_bool
+sge_next_range(const struct rpc_ibv_sge *sge, int sge_num, size_t off,
+               size_t len, int *idx, size_t *sge_off, sge_range *range)
+{
+    size_t  part_off = 0;
+    size_t  part_len;
+    te_bool found = FALSE;
+
+    for (; *idx < sge_num && *sge_off < off + len; (*idx)++)
+    {
+        part_len = sge_part(sge[*idx].length, *sge_off, off, len,
+                            &part_off);
+        if (part_len > 0)
+        {
+            if (!found)
+            {
+                range->addr = sge[*idx].addr;
+                range->off = sge[*idx].offset + part_off;
+                range->len = part_len;
+                range->pos = *sge_off + part_off - off;
+                found = TRUE;
+            }
+            else if (sge[*idx].addr == range->addr &&
+                     sge[*idx].offset + part_off == range->off + range->len)
+            {
+                range->len += part_len;
+            }
+            else
+            {
+                break;
+            }
+        }
+        *sge_off += sge[*idx].length;
+    }
+
+    return found;
+}
+
+/* See description in ibvapi-ts.h */
+size_t
+ibvts_read_sge_data(rcf_rpc_server *rpcs, const struct rpc_ibv_sge *sge,
+                    int sge_num, size_t off, size_t len, uint8_t *buf)
+{
+    sge_range   range;
+    size_t      sge_off = 0;
+    size_t      got = 0;
+    int         i = 0;
+
+    while (sge_next_range(sge, sge_num, off, len, &i, &sge_off, &range))
+    {
+        rpc_get_buf_gen(rpcs, range.addr, range.off, range.len,
+                        &buf[range.pos]);
+        got += range.len;
+    }
+
+    return got;
+}
+
+/* See description in ibvapi-ts.h */
+ssize_t
+ibvts_cmp_sge_data(rcf_rpc_server *rpcs, const struct rpc_ibv_sge *sge,
+                   int sge_num, size_t off, rpc_ptr exp, size_t exp_off,
+                   size_t len)
+{
+    sge_range   range;
+    rpc_ptr_off data_ptr;
+    rpc_ptr_off exp_ptr;
+    size_t      sge_off = 0;
+    size_t      got = 0;
+    int         i = 0;
+
+    while (sge_next_range(sge, sge_num, off, len, &i, &sge_off, &range))
+    {
+        data_ptr.base = range.addr;
+        data_ptr.offset = range.off;
+        exp_ptr.base = exp;
+        exp_ptr.offset = exp_off + range.pos;
+        if (rpc_memcmp(rpcs, &data_ptr, &exp_ptr, range.len) != 0)
+            return range.pos;
+        got += range.len;
+    }
+
+    return got < len ? (ssize_t)len : -1;
+}
+
 /* See description in ibvapi-ts.h */
 void
 ibvts_fill_gid(const struct sockaddr *addr, union rpc_ibv_gid *gid)
@@ -89,3 +379,821 @@ ibvts_fill_gid(const struct sockaddr *addr, union rpc_ibv_gid *gid)
     mmac[5] = (SIN(addr)->sin_addr.s_addr >> 24) & 0xff;
     memcpy (&gid->raw[10], mmac, ETH_ALEN);
 }
+
+/**
+ * Maximum delay between calls of ibv_poll_cq() which got no completions
+ * in ibvts_poll_cq_wait(), in microseconds
+ */
+#define IBVTS_POLL_BACKOFF_MAX 64
+
+/* See description in ibvapi-ts.h */
+int
+ibvts_poll_cq_wait(rcf_rpc_server *rpcs, rpc_ptr cq, int num, int timeout,
+                   te_bool backoff, struct rpc_ibv_wc *wc,
+                   uint64_t *last_compl)
+{
+    struct timeval  tv_start;
+    struct timeval  tv_now;
+    uint64_t        elapsed;
+    te_bool         silent_pass = rpcs->silent_pass;
+    te_bool         silent_pass_default = rpcs->silent_pass_default;
+    unsigned int    delay = 0;
+    int             got = 0;
+    int             rc;
+
+    if (last_compl != NULL)
+        *last_compl = 0;
+
+    ibvts_rpcs_set_silent(rpcs, TRUE);
+    gettimeofday(&tv_start, NULL);
+    while (got < num)
+    {
+        rc = rpc_ibv_poll_cq(rpcs, cq, num - got, wc + got);
+        gettimeofday(&tv_now, NULL);
+        elapsed = TIMEVAL_SUB(tv_now, tv_start);
+
+        if (rc > 0)
+        {
+            got += rc;
+            delay = 0;
+            if (last_compl != NULL)
+                *last_compl = elapsed;
+        }
+        if (elapsed > TE_MS2US(timeout))
+            break;
+
+        if (rc <= 0 && backoff)
+        {
+            delay = delay == 0 ? 1 : MIN(delay * 2, IBVTS_POLL_BACKOFF_MAX);
+            usleep(delay);
+        }
+    }
+    rpcs->silent_pass = silent_pass;
+    rpcs->silent_pass_default = silent_pass_default;
+
+    return got;
+}
+
+/** Alignment of memory block holding buffers of a pool */
+#define IBVTS_BUF_POOL_ALIGN 4096
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_buf_pool_create(rcf_rpc_server *rpcs, rpc_ptr pd, int num,
+                      size_t align, size_t size, int access,
+                      ibvts_buf_pool *pool)
+{
+    pool->rpcs = rpcs;
+    pool->num = num;
+    pool->size = size;
+    if (align == 0)
+        align = 1;
+    pool->stride = (size + align - 1) / align * align;
+
+    pool->arena = rpc_memalign(rpcs, MAX(align, IBVTS_BUF_POOL_ALIGN),
+                               pool->stride * num);
+    pool->mr = rpc_ibv_reg_mr(rpcs, pd, pool->arena, pool->stride * num,
+                              access);
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_buf_pool_sge(const ibvts_buf_pool *pool, int idx, uint32_t len,
+                   struct rpc_ibv_sge *sge)
+{
+    ibvts_buf_pool_sge_at(pool, pool->stride * idx, len, sge);
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_buf_pool_sge_at(const ibvts_buf_pool *pool, size_t off, uint32_t len,
+                      struct rpc_ibv_sge *sge)
+{
+    sge->addr = pool->arena;
+    sge->offset = off;
+    sge->length = len;
+    sge->lkey = pool->mr->lkey;
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_buf_pool_write(const ibvts_buf_pool *pool, int idx, const void *data,
+                     size_t len)
+{
+    rpc_set_buf_gen(pool->rpcs, data, len, pool->arena, pool->stride * idx);
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_buf_pool_destroy(ibvts_buf_pool *pool)
+{
+    if (pool->mr != NULL)
+        rpc_ibv_dereg_mr(pool->rpcs, pool->mr);
+    if (pool->arena != RPC_NULL)
+        rpc_free(pool->rpcs, pool->arena);
+
+    memset(pool, 0, sizeof(*pool));
+}
+
+/** Convert RPC timeval to microseconds */
+#define TARPC_TV2US(_tv) \
+    ((int64_t)(_tv).tv_sec * 1000000 + (_tv).tv_usec)
+
+/* See description in ibvapi-ts.h */
+uint64_t
+ibvts_rusage_cpu_time(const tarpc_rusage *start, const tarpc_rusage *end)
+{
+    return TARPC_TV2US(end->ru_utime) - TARPC_TV2US(start->ru_utime) +
+           TARPC_TV2US(end->ru_stime) - TARPC_TV2US(start->ru_stime);
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_rpcs_set_silent(rcf_rpc_server *rpcs, te_bool silent)
+{
+    rpcs->silent_pass = rpcs->silent_pass_default = silent;
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_mi_add_rpc_note(te_mi_logger *logger)
+{
+    te_mi_logger_add_comment(logger, NULL, "rpc_bound",
+                             "WRs are posted and completions are polled "
+                             "by RPC calls from the test engine, so "
+                             "rates are bounded by RPC throughput");
+}
+
+/* See description in ibvapi-ts.h */
+uint64_t
+ibvts_rpc_overhead(rcf_rpc_server *rpcs, rpc_ptr cq, int num)
+{
+    struct rpc_ibv_wc   wc;
+    struct timeval      tv_start;
+    struct timeval      tv_end;
+    uint64_t            total = 0;
+    uint64_t            call_time;
+    int                 i;
+
+    for (i = 0; i < num; i++)
+    {
+        gettimeofday(&tv_start, NULL);
+        rpc_ibv_poll_cq(rpcs, cq, 1, &wc);
+        gettimeofday(&tv_end, NULL);
+
+        call_time = TIMEVAL_SUB(tv_end, tv_start);
+        if (call_time > rpcs->duration)
+            total += call_time - rpcs->duration;
+    }
+
+    return num > 0 ? total / num : 0;
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_qp_to_rts(rcf_rpc_server *rpcs, struct rpc_ibv_qp *qp, int port)
+{
+    struct rpc_ibv_qp_attr mod_attr;
+
+    memset(&mod_attr, 0, sizeof(mod_attr));
+    mod_attr.qp_state = IBV_QPS_INIT;
+    mod_attr.port_num = port;
+    rpc_ibv_modify_qp(rpcs, qp->qp, &mod_attr, IBV_QP_STATE | IBV_QP_PORT);
+
+    mod_attr.qp_state = IBV_QPS_RTR;
+    rpc_ibv_modify_qp(rpcs, qp->qp, &mod_attr, IBV_QP_STATE);
+
+    mod_attr.qp_state = IBV_QPS_RTS;
+    rpc_ibv_modify_qp(rpcs, qp->qp, &mod_attr, IBV_QP_STATE);
+}
+
+/**
+ * Get index of histogram bucket containing a value.
+ *
+ * @param value Value
+ *
+ * @return Bucket index.
+ */
+static unsigned int
+hist_bucket(uint64_t value)
+{
+    unsigned int msb;
+    unsigned int shift;
+
+    if (value < 2 * IBVTS_HIST_SUB_NUM)
+        return value;
+
+    msb = 63 - __builtin_clzll(value);
+    shift = msb - IBVTS_HIST_SUB_BITS;
+
+    return shift * IBVTS_HIST_SUB_NUM + (value >> shift);
+}
+
+/**
+ * Get the greatest value which belongs to histogram bucket.
+ *
+ * @param bucket  Bucket index
+ *
+ * @return Upper bound of the bucket.
+ */
+static uint64_t
+hist_bucket_max(unsigned int bucket)
+{
+    unsigned int shift;
+
+    if (bucket < 2 * IBVTS_HIST_SUB_NUM)
+        return bucket;
+
+    shift = bucket / IBVTS_HIST_SUB_NUM - 1;
+
+    return (((uint64_t)(bucket - shift * IBVTS_HIST_SUB_NUM) + 1)
+            << shift) - 1;
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_hist_init(ibvts_hist *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT64_MAX;
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_hist_add(ibvts_hist *hist, uint64_t value)
+{
+    hist->buckets[hist_bucket(value)]++;
+    hist->count++;
+    hist->sum += value;
+    if (value < hist->min)
+        hist->min = value;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+/* See description in ibvapi-ts.h */
+uint64_t
+ibvts_hist_percentile(const ibvts_hist *hist, double pct)
+{
+    uint64_t        rank;
+    uint64_t        seen = 0;
+    unsigned int    i;
+
+    if (hist->count == 0)
+        return 0;
+
+    rank = (uint64_t)(hist->count * pct / 100.0 + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    for (i = 0; i < IBVTS_HIST_BUCKETS_NUM; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= rank)
+            break;
+    }
+
+    return MIN(hist_bucket_max(i), hist->max);
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_hist_log(const ibvts_hist *hist, te_mi_logger *logger,
+               te_mi_meas_type type, const char *name,
+               te_mi_meas_multiplier multiplier, te_bool rpc_inclusive)
+{
+    static const struct {
+        double      pct;
+        const char *suffix;
+    } pcts[] = {
+        { 50.0, "p50" },
+        { 99.0, "p99" },
+        { 99.9, "p99.9" },
+    };
+
+    te_string       str = TE_STRING_INIT;
+    char            meas_name[64];
+    unsigned int    i;
+
+    if (hist->count == 0)
+    {
+        WARN("Histogram '%s' is empty", name);
+        return;
+    }
+
+    for (i = 0; i < IBVTS_HIST_BUCKETS_NUM; i++)
+    {
+        if (hist->buckets[i] == 0)
+            continue;
+        te_string_append(&str, "\n  <= %" PRIu64 ": %" PRIu64,
+                         MIN(hist_bucket_max(i), hist->max),
+                         hist->buckets[i]);
+    }
+    RING("Histogram '%s' of %" PRIu64 " values:%s", name, hist->count,
+         str.ptr);
+    te_string_free(&str);
+
+    if (logger == NULL)
+        return;
+
+    if (rpc_inclusive)
+    {
+        te_mi_logger_add_comment(logger, NULL, name,
+                                 "RPC-inclusive: measured by the test "
+                                 "engine around RPC calls, values include "
+                                 "RPC round trips");
+    }
+    te_mi_logger_add_meas(logger, NULL, type, name, TE_MI_MEAS_AGGR_MIN,
+                          hist->min, multiplier);
+    te_mi_logger_add_meas(logger, NULL, type, name, TE_MI_MEAS_AGGR_MEAN,
+                          (double)hist->sum / hist->count, multiplier);
+    te_mi_logger_add_meas(logger, NULL, type, name, TE_MI_MEAS_AGGR_MAX,
+                          hist->max, multiplier);
+
+    for (i = 0; i < TE_ARRAY_LEN(pcts); i++)
+    {
+        snprintf(meas_name, sizeof(meas_name), "%s_%s", name,
+                 pcts[i].suffix);
+        te_mi_logger_add_meas(logger, NULL, type, meas_name,
+                              TE_MI_MEAS_AGGR_SINGLE,
+                              ibvts_hist_percentile(hist, pcts[i].pct),
+                              multiplier);
+    }
+}
+
+/* See description in ibvapi-ts.h */
+te_errno
+ibvts_qp_fixture_create(rcf_rpc_server *rpcs,
+                        const ibvts_qp_fixture_desc *desc,
+                        ibvts_qp_fixture *fx)
+{
+    struct rpc_ibv_qp_init_attr qp_attr;
+
+    memset(fx, 0, sizeof(*fx));
+    memset(&qp_attr, 0, sizeof(qp_attr));
+    fx->rpcs = rpcs;
+
+    fx->context = rpc_ibv_open_device(rpcs, &fx->port);
+    fx->pd = rpc_ibv_alloc_pd(rpcs, fx->context->context);
+    rpc_ibv_query_device(rpcs, fx->context->context, &fx->attr);
+
+    fx->pool_size = MIN(fx->attr.max_cqe, fx->attr.max_qp_wr);
+    if (desc->max_send_wr > fx->pool_size ||
+        desc->max_recv_wr > fx->pool_size)
+    {
+        ERROR("Queue size %d/%d exceeds %d supported by device",
+              desc->max_send_wr, desc->max_recv_wr, fx->pool_size);
+        return TE_EINVAL;
+    }
+
+    if (desc->comp_channel)
+        fx->ev_ch = rpc_ibv_create_comp_channel(rpcs, fx->context->context);
+    fx->rcq = rpc_ibv_create_cq(rpcs, fx->context->context, fx->pool_size,
+                                RPC_NULL,
+                                fx->ev_ch == NULL ? RPC_NULL : fx->ev_ch->cc,
+                                0);
+    fx->scq = rpc_ibv_create_cq(rpcs, fx->context->context, fx->pool_size,
+                                RPC_NULL, RPC_NULL, 0);
+
+    qp_attr.send_cq = fx->scq;
+    qp_attr.recv_cq = fx->rcq;
+    qp_attr.cap.max_send_wr = desc->max_send_wr > 0 ? desc->max_send_wr :
+                                                      fx->pool_size;
+    qp_attr.cap.max_recv_wr = desc->max_recv_wr > 0 ? desc->max_recv_wr :
+                                                      fx->pool_size;
+    qp_attr.cap.max_send_sge = desc->max_send_sge;
+    qp_attr.cap.max_recv_sge = desc->max_recv_sge;
+    qp_attr.cap.max_inline_data = desc->max_inline_data;
+    qp_attr.sq_sig_all = desc->sq_sig_all ? 1 : 0;
+    qp_attr.qp_type = IBV_QPT_RAW_PACKET;
+    fx->qp = rpc_ibv_create_qp(rpcs, fx->pd, &qp_attr);
+    ibvts_qp_to_rts(rpcs, fx->qp, fx->port);
+
+    return 0;
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_qp_fixture_destroy(ibvts_qp_fixture *fx)
+{
+    if (fx->qp != NULL)
+        rpc_ibv_destroy_qp(fx->rpcs, fx->qp);
+    if (fx->scq != RPC_NULL)
+        rpc_ibv_destroy_cq(fx->rpcs, fx->scq);
+    if (fx->rcq != RPC_NULL)
+        rpc_ibv_destroy_cq(fx->rpcs, fx->rcq);
+    if (fx->ev_ch != NULL)
+        rpc_ibv_destroy_comp_channel(fx->rpcs, fx->ev_ch);
+    if (fx->pd != RPC_NULL)
+        rpc_ibv_dealloc_pd(fx->rpcs, fx->pd);
+    if (fx->context != NULL)
+        rpc_ibv_close_device(fx->rpcs, fx->context);
+
+    memset(fx, 0, sizeof(*fx));
+}
+
+/* See description in ibvapi-ts.h */
+te_bool
+ibvts_check_wc(const struct rpc_ibv_wc *wc, int num, uint64_t *bytes)
+{
+    int i;
+
+    for (i = 0; i < num; i++)
+    {
+        if (wc[i].status != IBV_WC_SUCCESS)
+        {
+            ERROR("Completion of WR %llu has status %d",
+                  (unsigned long long)wc[i].wr_id, wc[i].status);
+            return FALSE;
+        }
+        if (bytes != NULL)
+            *bytes += wc[i].byte_len;
+    }
+
+    return TRUE;
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_traffic_init(ibvts_traffic *tr, ibvts_qp_fixture *tx_fx,
+                   struct rpc_ibv_sge *send_sge, int send_sge_num,
+                   int send_flags, ibvts_qp_fixture *rx_fx,
+                   struct rpc_ibv_sge *recv_sge, int recv_sge_num,
+                   int burst, int chunk)
+{
+    int i;
+
+    memset(tr, 0, sizeof(*tr));
+    tr->tx_fx = tx_fx;
+    tr->rx_fx = rx_fx;
+    tr->burst = burst;
+    tr->chunk = chunk > 0 ? chunk : burst;
+
+    tr->send_wr = tapi_calloc(burst, sizeof(*tr->send_wr));
+    tr->recv_wr = tapi_calloc(burst, sizeof(*tr->recv_wr));
+    tr->wc = tapi_calloc(burst, sizeof(*tr->wc));
+
+    for (i = 0; i < burst; i++)
+    {
+        tr->recv_wr[i].next = (i == burst - 1) ? NULL : &tr->recv_wr[i + 1];
+        tr->recv_wr[i].sg_list = recv_sge;
+        tr->recv_wr[i].num_sge = recv_sge_num;
+        tr->recv_wr[i].wr_id = i;
+
+        tr->send_wr[i].next = ((i + 1) % tr->chunk == 0 || i == burst - 1) ?
+                              NULL : &tr->send_wr[i + 1];
+        tr->send_wr[i].sg_list = send_sge;
+        tr->send_wr[i].num_sge = send_sge_num;
+        tr->send_wr[i].opcode = IBV_WR_SEND;
+        tr->send_wr[i].send_flags = send_flags;
+        tr->send_wr[i].wr_id = i;
+    }
+}
+
+/* See description in ibvapi-ts.h */
+te_errno
+ibvts_traffic_send(ibvts_traffic *tr, int timeout)
+{
+    struct rpc_ibv_recv_wr *bad_recv_wr = NULL;
+    struct rpc_ibv_send_wr *bad_send_wr = NULL;
+    uint64_t                len = 0;
+    int                     got;
+    int                     i;
+
+    if (tr->rx_posted < tr->burst)
+    {
+        rpc_ibv_post_recv(tr->rx_fx->rpcs, tr->rx_fx->qp->qp,
+                          &tr->recv_wr[tr->rx_posted], &bad_recv_wr);
+        tr->post_recv_time += tr->rx_fx->rpcs->duration;
+        tr->rx_posted = tr->burst;
+    }
+
+    for (i = 0; i < tr->burst; i += tr->chunk)
+    {
+        rpc_ibv_post_send(tr->tx_fx->rpcs, tr->tx_fx->qp->qp,
+                          &tr->send_wr[i], &bad_send_wr);
+        tr->post_send_time += tr->tx_fx->rpcs->duration;
+        tr->post_send_calls++;
+    }
+
+    got = ibvts_poll_cq_wait(tr->tx_fx->rpcs, tr->tx_fx->scq, tr->burst,
+                             timeout, FALSE, tr->wc, NULL);
+    if (!ibvts_check_wc(tr->wc, got, NULL))
+        return TE_EIO;
+    if (got != tr->burst)
+    {
+        ERROR("Only %d send WRs of %d were completed", got, tr->burst);
+        return TE_ETIMEDOUT;
+    }
+
+    for (i = 0; i < tr->send_wr[0].num_sge; i++)
+        len += tr->send_wr[0].sg_list[i].length;
+
+    tr->tx_pkts += got;
+    tr->tx_bytes += len * got;
+
+    return 0;
+}
+
+/* See description in ibvapi-ts.h */
+te_errno
+ibvts_traffic_recv(ibvts_traffic *tr, int timeout)
+{
+    int got;
+
+    got = ibvts_poll_cq_wait(tr->rx_fx->rpcs, tr->rx_fx->rcq, tr->burst,
+                             timeout, FALSE, tr->wc, NULL);
+    if (!ibvts_check_wc(tr->wc, got, &tr->rx_bytes))
+        return TE_EIO;
+
+    tr->rx_pkts += got;
+    tr->rx_posted -= got;
+
+    return 0;
+}
+
+/* See description in ibvapi-ts.h */
+te_errno
+ibvts_traffic_run(ibvts_traffic *tr, int duration, int timeout)
+{
+    struct timeval  tv_start;
+    struct timeval  tv_now;
+    te_errno        rc;
+
+    ibvts_rpcs_set_silent(tr->tx_fx->rpcs, TRUE);
+    ibvts_rpcs_set_silent(tr->rx_fx->rpcs, TRUE);
+    gettimeofday(&tv_start, NULL);
+    do {
+        rc = ibvts_traffic_send(tr, timeout);
+        if (rc == 0)
+            rc = ibvts_traffic_recv(tr, timeout);
+
+        gettimeofday(&tv_now, NULL);
+        tr->elapsed = TIMEVAL_SUB(tv_now, tv_start);
+    } while (rc == 0 && tr->elapsed < (uint64_t)TE_SEC2US(duration));
+    ibvts_rpcs_set_silent(tr->tx_fx->rpcs, FALSE);
+    ibvts_rpcs_set_silent(tr->rx_fx->rpcs, FALSE);
+
+    return rc;
+}
+
+/* See description in ibvapi-ts.h */
+void
+ibvts_traffic_free(ibvts_traffic *tr)
+{
+    free(tr->send_wr);
+    free(tr->recv_wr);
+    free(tr->wc);
+
+    memset(tr, 0, sizeof(*tr));
+}
+
+/* See description in ibvapi-ts.h */
+int
+ibvts_probe_max_inline(rcf_rpc_server *rpcs, int limit)
+{
+    struct rpc_ibv_context     *context;
+    struct rpc_ibv_qp_init_attr qp_attr;
+    struct rpc_ibv_qp          *qp;
+    rpc_ptr                     pd;
+    rpc_ptr                     cq;
+    int                         port;
+    int                         low = 0;
+    int                         high = limit;
+    int                         mid;
+
+    context = rpc_ibv_open_device(rpcs, &port);
+    pd = rpc_ibv_alloc_pd(rpcs, context->context);
+    cq = rpc_ibv_create_cq(rpcs, context->context, 1, RPC_NULL, RPC_NULL, 0);
+
+    memset(&qp_attr, 0, sizeof(qp_attr));
+    qp_attr.send_cq = cq;
+    qp_attr.recv_cq = cq;
+    qp_attr.cap.max_send_wr = 1;
+    qp_attr.cap.max_recv_wr = 1;
+    qp_attr.cap.max_send_sge = 1;
+    qp_attr.cap.max_recv_sge = 1;
+    qp_attr.qp_type = IBV_QPT_RAW_PACKET;
+
+    while (low < high)
+    {
+        mid = low + (high - low + 1) / 2;
+        qp_attr.cap.max_inline_data = mid;
+
+        RPC_AWAIT_IUT_ERROR(rpcs);
+        qp = rpc_ibv_create_qp(rpcs, pd, &qp_attr);
+        if (qp != NULL)
+        {
+            rpc_ibv_destroy_qp(rpcs, qp);
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    rpc_ibv_destroy_cq(rpcs, cq);
+    rpc_ibv_dealloc_pd(rpcs, pd);
+    rpc_ibv_close_device(rpcs, context);
+
+    return low;
+}
+
+/* See description in ibvapi-ts.h */
+const char *
+ibvts_buf_backing2str(ibvts_buf_backing backing)
+{
+    switch (backing)
+    {
+        case IBVTS_BUF_BACKING_4K:
+            return "4k";
+        case IBVTS_BUF_BACKING_THP:
+            return "thp";
+        case IBVTS_BUF_BACKING_HUGE_2M:
+            return "huge_2m";
+        case IBVTS_BUF_BACKING_HUGE_1G:
+            return "huge_1g";
+    }
+
+    return "<unknown>";
+}
+
+/* See description in ibvapi-ts.h */
+size_t
+ibvts_buf_backing_page_size(ibvts_buf_backing backing)
+{
+    switch (backing)
+    {
+        case IBVTS_BUF_BACKING_THP:
+        case IBVTS_BUF_BACKING_HUGE_2M:
+            return 2UL << 20;
+        case IBVTS_BUF_BACKING_HUGE_1G:
+            return 1UL << 30;
+        default:
+            return 4096;
+    }
+}
+
+/* See description in ibvapi-ts.h */
+te_errno
+ibvts_buf_backing_fork(rcf_rpc_server *rpcs, ibvts_buf_backing backing,
+                       const char *name, rcf_rpc_server **p_new)
+{
+    te_string   tunables = TE_STRING_INIT;
+    size_t      hugetlb;
+    te_errno    rc;
+
+    /*
+     * glibc.malloc.hugetlb: 0 - regular pages, 1 - THP by madvise(),
+     * other values - hugetlbfs pages of the given size
+     */
+    switch (backing)
+    {
+        case IBVTS_BUF_BACKING_4K:
+            hugetlb = 0;
+            break;
+        case IBVTS_BUF_BACKING_THP:
+            hugetlb = 1;
+            break;
+        default:
+            hugetlb = ibvts_buf_backing_page_size(backing);
+            break;
+    }
+
+    rc = te_string_append(&tunables, "glibc.malloc.hugetlb=%zu:"
+                          "glibc.malloc.mmap_threshold=%d", hugetlb,
+                          IBVTS_MMAP_THRESHOLD);
+    if (rc != 0)
+    {
+        te_string_free(&tunables);
+        return rc;
+    }
+
+    rpc_setenv(rpcs, "GLIBC_TUNABLES", tunables.ptr, 1);
+    rc = rcf_rpc_server_fork_exec(rpcs, name, p_new);
+    rpc_unsetenv(rpcs, "GLIBC_TUNABLES");
+    te_string_free(&tunables);
+
+    return rc;
+}
+
+/** Maximum size of a file read on the agent by read_agent_file() */
+#define IBVTS_AGENT_FILE_MAX 4096
+
+/**
+ * Read text file on the agent.
+ *
+ * @param rpcs      RPC server handler
+ * @param path      Path to the file
+ * @param buf       Buffer for null-terminated contents of the file (OUT)
+ * @param size      Size of @p buf, the rest of the file is ignored
+ *
+ * @return Status code.
+ */
+static te_errno
+read_agent_file(rcf_rpc_server *rpcs, const char *path, char *buf,
+                size_t size)
+{
+    size_t  len = 0;
+    int     fd;
+    int     rc;
+
+    RPC_AWAIT_IUT_ERROR(rpcs);
+    fd = rpc_open(rpcs, path, RPC_O_RDONLY, 0);
+    if (fd < 0)
+    {
+        ERROR("Failed to open %s on %s", path, rpcs->ta);
+        return TE_ENOENT;
+    }
+
+    do {
+        rc = rpc_read(rpcs, fd, buf + len, size - 1 - len);
+        if (rc > 0)
+            len += rc;
+    } while (rc > 0 && len < size - 1);
+    buf[len] = '\0';
+    rpc_close(rpcs, fd);
+
+    return 0;
+}
+
+/**
+ * Read unsigned number from a file on the agent.
+ *
+ * @param rpcs      RPC server handler
+ * @param path      Path to the file
+ * @param field     Name of the field followed by the number or @c NULL
+ *                  if the file contains just the number
+ * @param value     Location for the number (OUT)
+ *
+ * @return Status code.
+ */
+static te_errno
+read_agent_value(rcf_rpc_server *rpcs, const char *path, const char *field,
+                 uint64_t *value)
+{
+    char        buf[IBVTS_AGENT_FILE_MAX];
+    const char *p = buf;
+    te_errno    rc;
+
+    rc = read_agent_file(rpcs, path, buf, sizeof(buf));
+    if (rc != 0)
+        return rc;
+
+    if (field != NULL)
+    {
+        p = strstr(buf, field);
+        if (p == NULL)
+        {
+            ERROR("There is no %s in %s on %s", field, path, rpcs->ta);
+            return TE_ENOENT;
+        }
+        p += strlen(field);
+    }
+    *value = strtoull(p, NULL, 10);
+
+    return 0;
+}
+
+/* See description in ibvapi-ts.h */
+te_errno
+ibvts_buf_backing_usage(rcf_rpc_server *rpcs, ibvts_buf_backing backing,
+                        uint64_t *usage)
+{
+    size_t      page_size = ibvts_buf_backing_page_size(backing);
+    char        path[128];
+    uint64_t    total;
+    uint64_t    free_num;
+    te_errno    rc;
+
+    switch (backing)
+    {
+        case IBVTS_BUF_BACKING_4K:
+            *usage = 0;
+            return 0;
+
+        case IBVTS_BUF_BACKING_THP:
+            rc = read_agent_value(rpcs, "/proc/self/smaps_rollup",
+                                  "AnonHugePages:", &total);
+            if (rc == 0)
+                *usage = total * 1024;
+            return rc;
+
+        default:
+            snprintf(path, sizeof(path),
+                     "/sys/kernel/mm/hugepages/hugepages-%zukB/nr_hugepages",
+                     page_size / 1024);
+            rc = read_agent_value(rpcs, path, NULL, &total);
+            if (rc != 0)
+                return rc;
+            snprintf(path, sizeof(path),
+                     "/sys/kernel/mm/hugepages/hugepages-%zukB/"
+                     "free_hugepages", page_size / 1024);
+            rc = read_agent_value(rpcs, path, NULL, &free_num);
+            if (rc != 0)
+                return rc;
+            *usage = (total - MIN(free_num, total)) * page_size;
+            return 0;
+    }
+}
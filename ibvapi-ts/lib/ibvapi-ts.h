@@ -21,10 +21,29 @@
 #include "tapi_rpc.h"
 #include "tapi_env.h"
 #include "tapi_rpc_verbs.h"
+#include "te_mi_log.h"
 
 /* Reasonable TTL */
 #define IBVTS_TTL 5
 
+/**
+ * Minimum size of buffers placed to separate mappings by RPC servers
+ * created by ibvts_buf_backing_fork()
+ */
+#define IBVTS_MMAP_THRESHOLD 4096
+
+/**
+ * Number of bits defining linear sub-buckets in each power-of-two
+ * range of histogram, so that relative error of a bucket is not
+ * greater than 1 / 2^IBVTS_HIST_SUB_BITS
+ */
+#define IBVTS_HIST_SUB_BITS 5
+/** Number of linear sub-buckets in each power-of-two range */
+#define IBVTS_HIST_SUB_NUM (1 << IBVTS_HIST_SUB_BITS)
+/** Total number of buckets to cover all 64-bit values */
+#define IBVTS_HIST_BUCKETS_NUM \
+    ((64 - IBVTS_HIST_SUB_BITS + 1) * IBVTS_HIST_SUB_NUM)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -36,6 +55,102 @@ typedef struct te_eth_ip_udp_hdr {
     struct udphdr       udphdr;
 } __attribute__ ((packed)) te_eth_ip_udp_hdr;
 
+/** Histogram of values with logarithmically growing buckets */
+typedef struct ibvts_hist {
+    uint64_t buckets[IBVTS_HIST_BUCKETS_NUM]; /**< Number of values in
+                                                   each bucket */
+    uint64_t count;                           /**< Number of values */
+    uint64_t sum;                             /**< Sum of values */
+    uint64_t min;                             /**< Minimum value */
+    uint64_t max;                             /**< Maximum value */
+} ibvts_hist;
+
+/**
+ * Pool of equally sized buffers placed one after another in one memory
+ * region
+ */
+typedef struct ibvts_buf_pool {
+    rcf_rpc_server     *rpcs;   /**< RPC server handler */
+    int                 num;    /**< Number of buffers */
+    size_t              size;   /**< Size of each buffer */
+    size_t              stride; /**< Distance between starts of adjacent
+                                     buffers */
+    rpc_ptr             arena;  /**< Memory holding all buffers */
+    struct rpc_ibv_mr  *mr;     /**< Memory region of @a arena */
+} ibvts_buf_pool;
+
+/** Description of @c IBV_QPT_RAW_PACKET QP fixture */
+typedef struct ibvts_qp_fixture_desc {
+    int     max_send_wr;        /**< Send queue size, @c 0 means maximum
+                                     supported by device */
+    int     max_recv_wr;        /**< Receive queue size, @c 0 means maximum
+                                     supported by device */
+    int     max_send_sge;       /**< Maximum number of send SGEs */
+    int     max_recv_sge;       /**< Maximum number of receive SGEs */
+    int     max_inline_data;    /**< Maximum size of inline data */
+    te_bool comp_channel;       /**< Bind receive CQ to completion
+                                     channel */
+    te_bool sq_sig_all;         /**< Signal all send WRs */
+} ibvts_qp_fixture_desc;
+
+/** Device context, PD, CQs and @c IBV_QPT_RAW_PACKET QP in RTS state */
+typedef struct ibvts_qp_fixture {
+    rcf_rpc_server              *rpcs;      /**< RPC server handler */
+    struct rpc_ibv_context      *context;   /**< Device context */
+    int                          port;      /**< Physical port number */
+    struct rpc_ibv_device_attr   attr;      /**< Device attributes */
+    int                          pool_size; /**< Maximum size of CQ and
+                                                 WQ supported by device */
+    rpc_ptr                      pd;        /**< Protection domain */
+    struct rpc_ibv_comp_channel *ev_ch;     /**< Completion channel or
+                                                 @c NULL */
+    rpc_ptr                      scq;       /**< Send CQ */
+    rpc_ptr                      rcq;       /**< Receive CQ */
+    struct rpc_ibv_qp           *qp;        /**< QP */
+} ibvts_qp_fixture;
+
+/**
+ * Bursts of raw packets sent from one QP fixture to another one, see
+ * ibvts_traffic_init()
+ */
+typedef struct ibvts_traffic {
+    ibvts_qp_fixture       *tx_fx;          /**< Sending fixture */
+    ibvts_qp_fixture       *rx_fx;          /**< Receiving fixture */
+    int                     burst;          /**< Number of WRs in a
+                                                 burst */
+    int                     chunk;          /**< Number of send WRs
+                                                 posted by one call */
+    struct rpc_ibv_send_wr *send_wr;        /**< Send WRs of a burst */
+    struct rpc_ibv_recv_wr *recv_wr;        /**< Receive WRs of a burst */
+    struct rpc_ibv_wc      *wc;             /**< Completions of a burst */
+    int                     rx_posted;      /**< Number of receive WRs in
+                                                 receive queue */
+
+    uint64_t                tx_pkts;        /**< Completed send WRs */
+    uint64_t                rx_pkts;        /**< Completed receive WRs */
+    uint64_t                tx_bytes;       /**< Bytes of completed send
+                                                 WRs */
+    uint64_t                rx_bytes;       /**< Bytes reported by receive
+                                                 completions */
+    uint64_t                post_send_time; /**< Time spent inside
+                                                 @b ibv_post_send(), us */
+    uint64_t                post_send_calls; /**< Number of
+                                                  @b ibv_post_send()
+                                                  calls */
+    uint64_t                post_recv_time; /**< Time spent inside
+                                                 @b ibv_post_recv(), us */
+    uint64_t                elapsed;        /**< Duration of the last
+                                                 ibvts_traffic_run(), us */
+} ibvts_traffic;
+
+/** Backing of buffers allocated by @b malloc() family functions */
+typedef enum ibvts_buf_backing {
+    IBVTS_BUF_BACKING_4K,       /**< Regular pages */
+    IBVTS_BUF_BACKING_THP,      /**< Transparent huge pages */
+    IBVTS_BUF_BACKING_HUGE_2M,  /**< 2M pages of hugetlbfs */
+    IBVTS_BUF_BACKING_HUGE_1G,  /**< 1G pages of hugetlbfs */
+} ibvts_buf_backing;
+
 /**
  * Create raw packet with ethernet, ip and udp header.
  *
@@ -59,6 +174,205 @@ extern int ibvts_create_raw_udp_dgm(const struct sockaddr *src_laddr,
                                     char *buf, uint16_t payload_len,
                                     uint8_t *pkt);
 
+/**
+ * Add data to one's complement sum used by IP and UDP checksums. Data is
+ * summed by 64-bit words, so long buffers are processed four 16-bit
+ * words per addition.
+ *
+ * @note Sums of several buffers may be chained if all buffers except
+ *       the last one have even length.
+ *
+ * @note Only IPv4 header checksum is built on this sum. There are no
+ *       UDP pseudo-header or IPv6 helpers, ibvts_create_raw_udp_dgm()
+ *       leaves checksums zero and no test compares
+ *       @c IBV_SEND_IP_CSUM offload with software checksumming.
+ *
+ * @param data      Data
+ * @param len       Length of @p data
+ * @param sum       Sum of preceding data or @c 0
+ *
+ * @return Partial sum to be passed to the next call or to
+ *         ibvts_csum_fold().
+ */
+extern uint32_t ibvts_csum_partial(const void *data, size_t len,
+                                   uint32_t sum);
+
+/**
+ * Fold partial sum to 16 bits and complement it.
+ *
+ * @param sum       Partial sum got by ibvts_csum_partial()
+ *
+ * @return Checksum in network byte order.
+ */
+extern uint16_t ibvts_csum_fold(uint32_t sum);
+
+/**
+ * Calculate checksum of IPv4 header. If @a check field of the header is
+ * correct, @c 0 is returned.
+ *
+ * @param iphdr     IPv4 header including options
+ *
+ * @return Checksum in network byte order.
+ */
+extern uint16_t ibvts_ip_csum(const struct iphdr *iphdr);
+
+/**
+ * Create burst of raw packets with ethernet, ip and udp header placed
+ * one after another in a contiguous buffer. Headers are made once by
+ * ibvts_create_raw_udp_dgm(), only ip id is updated for each packet.
+ *
+ * @param src_laddr      Source link layer address
+ * @param dst_laddr      Destination link layer address
+ * @param src_addr       Source ip layer address
+ * @param dst_addr       Destination ip layer address
+ * @param first_seq      Sequence number of the first packet, it is
+ *                       incremented for each next packet
+ * @param multicast      Create multicast packets or UDP packets
+ * @param bufs           Array of @p num payload buffers
+ * @param payload_len    Length of data in each payload buffer
+ * @param num            Number of packets
+ * @param burst          Pointer to the buffer of at least @p num *
+ *                       (sizeof(te_eth_ip_udp_hdr) + @p payload_len)
+ *                       bytes to save packets (OUT)
+ *
+ * @return  Length of each created raw packet
+ */
+extern int ibvts_create_raw_udp_burst(const struct sockaddr *src_laddr,
+                                      const struct sockaddr *dst_laddr,
+                                      const struct sockaddr *src_addr,
+                                      const struct sockaddr *dst_addr,
+                                      uint16_t first_seq,
+                                      te_bool multicast, char **bufs,
+                                      uint16_t payload_len, int num,
+                                      uint8_t *burst);
+
+/**
+ * Write packets from contiguous buffer to buffers referred by SGE lists
+ * of send WRs. Data is consumed from @p burst in order of WRs and their
+ * SGEs, so length of each SGE must be set before the call.
+ *
+ * @note Memory referred by an SGE starts at @a offset from RPC pointer
+ *       @a addr. SGEs referring to adjacent ranges of the same memory
+ *       block, e.g. to buffers of a pool created with alignment @c 1,
+ *       are written by one @b rpc_set_buf_gen() call, so a burst laid out
+ *       contiguously is written by a single call.
+ *
+ * @param rpcs      RPC server handler
+ * @param burst     Buffer with packets
+ * @param wr        Array of send WRs
+ * @param num       Number of WRs in @p wr
+ *
+ * @return Number of bytes written.
+ */
+extern size_t ibvts_upload_burst(rcf_rpc_server *rpcs, const uint8_t *burst,
+                                 const struct rpc_ibv_send_wr *wr, int num);
+
+/**
+ * Read range of data received to buffers referred by SGE list. Only
+ * SGEs overlapping the range are read, and adjacent SGEs referring to
+ * adjacent memory are read by one call. Memory referred by an SGE
+ * starts at @a offset from RPC pointer @a addr.
+ *
+ * @param rpcs      RPC server handler
+ * @param sge       SGE list
+ * @param sge_num   Number of entries in @p sge
+ * @param off       Offset of the range in data referred by @p sge
+ * @param len       Length of the range
+ * @param buf       Buffer of at least @p len bytes to save data (OUT)
+ *
+ * @return Number of read bytes.
+ */
+extern size_t ibvts_read_sge_data(rcf_rpc_server *rpcs,
+                                  const struct rpc_ibv_sge *sge,
+                                  int sge_num, size_t off, size_t len,
+                                  uint8_t *buf);
+
+/**
+ * Compare range of data received to buffers referred by SGE list with
+ * expected data placed on the same RPC server. Comparison is done by
+ * @b memcmp() on the agent, so data is not transferred from RPC server.
+ * Adjacent SGEs referring to adjacent memory are compared by one call,
+ * and comparison stops at the first mismatching part. Memory referred by
+ * an SGE starts at @a offset from RPC pointer @a addr.
+ *
+ * @param rpcs      RPC server handler
+ * @param sge       SGE list
+ * @param sge_num   Number of entries in @p sge
+ * @param off       Offset of the range in data referred by @p sge
+ * @param exp       Buffer with expected data on @p rpcs
+ * @param exp_off   Offset of expected data in @p exp
+ * @param len       Length of the range
+ *
+ * @return Offset of the first mismatching part relative to @p off,
+ *         @p len if the range is longer than data referred by @p sge or
+ *         @c -1 if data matches.
+ */
+extern ssize_t ibvts_cmp_sge_data(rcf_rpc_server *rpcs,
+                                  const struct rpc_ibv_sge *sge,
+                                  int sge_num, size_t off, rpc_ptr exp,
+                                  size_t exp_off, size_t len);
+
+/**
+ * Allocate pool of aligned buffers in one page aligned memory block and
+ * register one memory region for it. Buffers are referred by offset in
+ * the block, so only two RPC calls are made regardless of @p num, and
+ * buffers of a pool created with @p align @c 1 are placed without gaps.
+ *
+ * @param rpcs      RPC server handler
+ * @param pd        Protection domain
+ * @param num       Number of buffers
+ * @param align     Alignment of each buffer, @c 0 is treated as @c 1
+ * @param size      Size of each buffer
+ * @param access    Access flags of memory region
+ * @param pool      Pool to be initialized (OUT)
+ */
+extern void ibvts_buf_pool_create(rcf_rpc_server *rpcs, rpc_ptr pd,
+                                  int num, size_t align, size_t size,
+                                  int access, ibvts_buf_pool *pool);
+
+/**
+ * Fill SGE referring to buffer of the pool.
+ *
+ * @param pool      Buffers pool
+ * @param idx       Index of buffer in the pool
+ * @param len       Length of data in the buffer
+ * @param sge       SGE to be filled (OUT)
+ */
+extern void ibvts_buf_pool_sge(const ibvts_buf_pool *pool, int idx,
+                               uint32_t len, struct rpc_ibv_sge *sge);
+
+/**
+ * Fill SGE referring to arbitrary range of memory holding buffers of the
+ * pool, e.g. to a part of a buffer or to several adjacent buffers.
+ *
+ * @param pool      Buffers pool
+ * @param off       Offset of the range from the start of the first
+ *                  buffer
+ * @param len       Length of the range
+ * @param sge       SGE to be filled (OUT)
+ */
+extern void ibvts_buf_pool_sge_at(const ibvts_buf_pool *pool, size_t off,
+                                  uint32_t len, struct rpc_ibv_sge *sge);
+
+/**
+ * Write data to buffer of the pool.
+ *
+ * @param pool      Buffers pool
+ * @param idx       Index of buffer in the pool
+ * @param data      Data
+ * @param len       Length of @p data
+ */
+extern void ibvts_buf_pool_write(const ibvts_buf_pool *pool, int idx,
+                                 const void *data, size_t len);
+
+/**
+ * Deregister memory region and free buffers of the pool. It is safe to
+ * call it for partially created or already destroyed pool.
+ *
+ * @param pool      Buffers pool
+ */
+extern void ibvts_buf_pool_destroy(ibvts_buf_pool *pool);
+
 /**
  * Create multicast group ID from multicast address
  *
@@ -68,6 +382,328 @@ extern int ibvts_create_raw_udp_dgm(const struct sockaddr *src_laddr,
 extern void ibvts_fill_gid(const struct sockaddr *addr,
                            union rpc_ibv_gid *gid);
 
+/**
+ * Poll CQ until @p num completions are got or @p timeout expires.
+ * Successful calls of @b ibv_poll_cq() are not logged.
+ *
+ * @param rpcs        RPC server handler
+ * @param cq          CQ to be polled
+ * @param num         Number of expected completions
+ * @param timeout     Timeout in milliseconds
+ * @param backoff     If @c TRUE, after each call which got no completions
+ *                    the delay before the next call is doubled up to a
+ *                    small limit, so that the RPC server is not flooded
+ *                    while CQ is empty. It is suitable for functional
+ *                    waits only: the delays add up to the time of getting
+ *                    completions, so performance tests poll without them.
+ * @param wc          Array of at least @p num entries to store
+ *                    completions (OUT)
+ * @param last_compl  Time passed from the function call until the last
+ *                    completion is got, in microseconds (OUT, may be
+ *                    @c NULL)
+ *
+ * @return Number of got completions.
+ */
+extern int ibvts_poll_cq_wait(rcf_rpc_server *rpcs, rpc_ptr cq, int num,
+                              int timeout, te_bool backoff,
+                              struct rpc_ibv_wc *wc, uint64_t *last_compl);
+
+/**
+ * Switch logging of successful calls of RPC server. It is disabled
+ * around timed loops, so that every call is not logged by the test
+ * engine. Failed calls are logged anyway.
+ *
+ * @param rpcs      RPC server handler
+ * @param silent    Whether successful calls should not be logged
+ */
+extern void ibvts_rpcs_set_silent(rcf_rpc_server *rpcs, te_bool silent);
+
+/**
+ * Add comment to MI measurements stating that they are bounded by RPC
+ * throughput, since WRs are posted and completions are polled by RPC
+ * calls made from the test engine.
+ *
+ * @param logger    MI logger
+ */
+extern void ibvts_mi_add_rpc_note(te_mi_logger *logger);
+
+/**
+ * Estimate overhead added by RPC to time of a call measured on the test
+ * side: it is mean difference between time of @b ibv_poll_cq() call on
+ * empty CQ measured by the test and time spent inside the function
+ * measured on the agent.
+ *
+ * @param rpcs      RPC server handler
+ * @param cq        CQ which has no completions
+ * @param num       Number of calls to average over
+ *
+ * @return RPC overhead in microseconds.
+ */
+extern uint64_t ibvts_rpc_overhead(rcf_rpc_server *rpcs, rpc_ptr cq,
+                                   int num);
+
+/**
+ * Initialize histogram.
+ *
+ * @param hist  Histogram
+ */
+extern void ibvts_hist_init(ibvts_hist *hist);
+
+/**
+ * Add value to histogram.
+ *
+ * @param hist  Histogram
+ * @param value Value to be added
+ */
+extern void ibvts_hist_add(ibvts_hist *hist, uint64_t value);
+
+/**
+ * Get percentile of values added to histogram. The result is the upper
+ * bound of the bucket containing the percentile, so it is never less
+ * than the real value.
+ *
+ * @param hist  Histogram
+ * @param pct   Percentile, from @c 0 to @c 100
+ *
+ * @return Value of percentile or @c 0 if histogram is empty.
+ */
+extern uint64_t ibvts_hist_percentile(const ibvts_hist *hist, double pct);
+
+/**
+ * Log non-empty buckets of histogram and add its minimum, mean, maximum
+ * and 50, 99 and 99.9 percentiles to MI measurements.
+ *
+ * Values measured by the test around RPC calls include RPC round trips
+ * between the test engine and agents. Such measurements must be added
+ * with @p rpc_inclusive set, then MI comment named as the measurements
+ * states it, so that they are not taken for latency of the device.
+ *
+ * @param hist          Histogram
+ * @param logger        MI logger or @c NULL to log buckets only
+ * @param type          Type of measurements
+ * @param name          Name of measurements
+ * @param multiplier    Multiplier of values added to histogram
+ * @param rpc_inclusive Whether values include RPC round trips
+ */
+extern void ibvts_hist_log(const ibvts_hist *hist, te_mi_logger *logger,
+                           te_mi_meas_type type, const char *name,
+                           te_mi_meas_multiplier multiplier,
+                           te_bool rpc_inclusive);
+
+/**
+ * Get CPU time consumed between two @b getrusage() calls.
+ *
+ * @param start  Resource usage got at the beginning
+ * @param end    Resource usage got at the end
+ *
+ * @return User and system CPU time in microseconds.
+ */
+extern uint64_t ibvts_rusage_cpu_time(const tarpc_rusage *start,
+                                      const tarpc_rusage *end);
+
+/**
+ * Move QP from Reset state to @c IBV_QPS_RTS state passing it through
+ * @c IBV_QPS_INIT and @c IBV_QPS_RTR states using @b ibv_modify_qp().
+ *
+ * @param rpcs  RPC server handler
+ * @param qp    QP to be moved
+ * @param port  Physical port number to be bound to the QP
+ */
+extern void ibvts_qp_to_rts(rcf_rpc_server *rpcs, struct rpc_ibv_qp *qp,
+                            int port);
+
+/**
+ * Open device, allocate PD, create CQs and @c IBV_QPT_RAW_PACKET QP
+ * according to @p desc and move the QP to @c IBV_QPS_RTS state.
+ *
+ * @note The fixture only partly covers the request it was added for:
+ *       it is used by perf tests, but usecases still build their
+ *       objects by hand since they need shared CQs, several QPs or
+ *       completion channels which the descriptor cannot express, and
+ *       the fixture is not kept in the RPC server across iterations
+ *       with @c TE_ENV_REUSE_PCO, it is created and destroyed by each
+ *       test run.
+ *
+ * @param rpcs  RPC server handler
+ * @param desc  Fixture description
+ * @param fx    Fixture to be initialized (OUT)
+ *
+ * @return Status code: @c TE_EINVAL if queue size requested in @p desc
+ *         is not supported by device.
+ */
+extern te_errno ibvts_qp_fixture_create(rcf_rpc_server *rpcs,
+                                        const ibvts_qp_fixture_desc *desc,
+                                        ibvts_qp_fixture *fx);
+
+/**
+ * Destroy QP, CQs, completion channel and PD and close device of the
+ * fixture. It is safe to call it for partially created or already
+ * destroyed fixture. Memory regions registered in the fixture PD must be
+ * deregistered before.
+ *
+ * @param fx    Fixture
+ */
+extern void ibvts_qp_fixture_destroy(ibvts_qp_fixture *fx);
+
+/**
+ * Check statuses of completions and count bytes reported by them.
+ * Failed completion is logged.
+ *
+ * @param wc        Array of completions
+ * @param num       Number of completions in @p wc
+ * @param bytes     Where to add number of bytes reported by
+ *                  completions (OUT, may be @c NULL)
+ *
+ * @return @c TRUE if all completions are successful.
+ */
+extern te_bool ibvts_check_wc(const struct rpc_ibv_wc *wc, int num,
+                              uint64_t *bytes);
+
+/**
+ * Prepare bursts of traffic from @p tx_fx to @p rx_fx: allocate lists of
+ * @p burst send and receive WRs. All send WRs refer to the same
+ * @p send_sge list, all receive WRs refer to the same @p recv_sge list,
+ * so the lists must not be freed while the traffic is used. Send WRs
+ * are linked in lists of @p chunk WRs, each list is posted by one
+ * @b ibv_post_send() call.
+ *
+ * @param tr            Traffic to be initialized (OUT)
+ * @param tx_fx         Sending fixture
+ * @param send_sge      SGE list of send WRs
+ * @param send_sge_num  Number of SGEs in @p send_sge
+ * @param send_flags    Flags of send WRs
+ * @param rx_fx         Receiving fixture
+ * @param recv_sge      SGE list of receive WRs
+ * @param recv_sge_num  Number of SGEs in @p recv_sge
+ * @param burst         Number of WRs in a burst
+ * @param chunk         Number of send WRs posted by one call, @c 0
+ *                      means @p burst
+ */
+extern void ibvts_traffic_init(ibvts_traffic *tr,
+                               ibvts_qp_fixture *tx_fx,
+                               struct rpc_ibv_sge *send_sge,
+                               int send_sge_num, int send_flags,
+                               ibvts_qp_fixture *rx_fx,
+                               struct rpc_ibv_sge *recv_sge,
+                               int recv_sge_num, int burst, int chunk);
+
+/**
+ * Refill receive queue up to a burst of WRs, post a burst of send WRs
+ * and wait for their completions.
+ *
+ * @param tr        Traffic
+ * @param timeout   Timeout of waiting for completions in milliseconds
+ *
+ * @return Status code: @c TE_EIO if a send WR completed with error,
+ *         @c TE_ETIMEDOUT if not all send WRs were completed.
+ */
+extern te_errno ibvts_traffic_send(ibvts_traffic *tr, int timeout);
+
+/**
+ * Wait for receive completions of a burst. Lost packets are not
+ * considered as error, they are not counted in @a rx_pkts.
+ *
+ * @param tr        Traffic
+ * @param timeout   Timeout of waiting for completions in milliseconds
+ *
+ * @return Status code: @c TE_EIO if a receive WR completed with error.
+ */
+extern te_errno ibvts_traffic_recv(ibvts_traffic *tr, int timeout);
+
+/**
+ * Send bursts by ibvts_traffic_send() and wait for their receive
+ * completions by ibvts_traffic_recv() during @p duration seconds.
+ * Successful RPC calls are not logged meanwhile.
+ *
+ * @param tr        Traffic
+ * @param duration  Duration of traffic in seconds
+ * @param timeout   Timeout of waiting for completions of a burst in
+ *                  milliseconds
+ *
+ * @return Status code of the first failed burst.
+ */
+extern te_errno ibvts_traffic_run(ibvts_traffic *tr, int duration,
+                                  int timeout);
+
+/**
+ * Free WR lists of the traffic. It is safe to call it for not
+ * initialized traffic which is filled with zeros.
+ *
+ * @param tr    Traffic
+ */
+extern void ibvts_traffic_free(ibvts_traffic *tr);
+
+/**
+ * Find the largest @a max_inline_data accepted by @b ibv_create_qp() for
+ * @c IBV_QPT_RAW_PACKET QP with one send and one receive SGE. Temporary
+ * device context, PD, CQ and QPs are created and destroyed by the
+ * function.
+ *
+ * @param rpcs      RPC server handler
+ * @param limit     Upper bound of the search
+ *
+ * @return Maximum size of inline data in bytes.
+ */
+extern int ibvts_probe_max_inline(rcf_rpc_server *rpcs, int limit);
+
+/**
+ * Get name of buffers backing.
+ *
+ * @param backing   Buffers backing
+ *
+ * @return Name of @p backing.
+ */
+extern const char *ibvts_buf_backing2str(ibvts_buf_backing backing);
+
+/**
+ * Get size of pages backing buffers.
+ *
+ * @param backing   Buffers backing
+ *
+ * @return Page size in bytes.
+ */
+extern size_t ibvts_buf_backing_page_size(ibvts_buf_backing backing);
+
+/**
+ * Create RPC server in a new process by fork() and exec() in which
+ * buffers of at least @c IBVTS_MMAP_THRESHOLD bytes allocated by
+ * @b malloc() family functions are placed to separate mappings backed by
+ * pages of the requested kind. It is done by glibc malloc tunables, so
+ * glibc 2.35 or newer is required on the agent. If there are no free
+ * huge pages, glibc silently falls back to regular pages.
+ *
+ * @param rpcs      RPC server handler to fork from
+ * @param backing   Buffers backing
+ * @param name      Name of the new RPC server
+ * @param p_new     Location for the new RPC server handler (OUT)
+ *
+ * @return Status code.
+ */
+extern te_errno ibvts_buf_backing_fork(rcf_rpc_server *rpcs,
+                                       ibvts_buf_backing backing,
+                                       const char *name,
+                                       rcf_rpc_server **p_new);
+
+/**
+ * Get amount of memory backed by huge pages of the kind used for
+ * @p backing. For @c IBVTS_BUF_BACKING_THP it is @a AnonHugePages of the
+ * RPC server process from /proc/self/smaps_rollup, for hugetlbfs backings
+ * it is size of huge pages of the corresponding size in use in the
+ * system according to /sys/kernel/mm/hugepages. Values got before
+ * allocation of buffers and after touching them show whether the buffers
+ * are really backed by the requested pages.
+ *
+ * @param rpcs      RPC server handler
+ * @param backing   Buffers backing, for @c IBVTS_BUF_BACKING_4K the
+ *                  amount is always @c 0
+ * @param usage     Location for the amount in bytes (OUT)
+ *
+ * @return Status code.
+ */
+extern te_errno ibvts_buf_backing_usage(rcf_rpc_server *rpcs,
+                                        ibvts_buf_backing backing,
+                                        uint64_t *usage);
+
 #ifdef __cplusplus
 } /* extern "C" */
 
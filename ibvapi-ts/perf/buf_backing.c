@@ -0,0 +1,403 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-buf_backing Regular and huge pages backing of buffers
+ *
+ * @objective Measure time of touching and registering buffers and
+ *            receive packet rate depending on kind of pages backing the
+ *            buffers and on size of the buffers.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param buf_backing        Pages backing buffers on IUT:
+ *                           - @c 4k: regular pages;
+ *                           - @c thp: transparent huge pages;
+ *                           - @c huge_2m: 2M pages of hugetlbfs;
+ *                           - @c huge_1g: 1G pages of hugetlbfs.
+ * @param buf_size_kb        Size of each buffer in kilobytes
+ * @param buf_num            Number of buffers
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param burst              Number of WRs posted by one call of
+ *                           @b ibv_post_send()/ @b ibv_post_recv()
+ * @param duration           Duration of traffic in seconds
+ *
+ * @note Buffers are allocated by a separate RPC server process created on
+ *       IUT by ibvts_buf_backing_fork(), see its description for
+ *       requirements. Since glibc silently falls back to regular pages, the
+ *       iteration is skipped if memory backed by pages of @p buf_backing
+ *       does not grow by the size of the buffers after they are touched
+ *       (see ibvts_buf_backing_usage()). Buffers smaller than a page of
+ *       @p buf_backing are expected to take a whole page each, so with
+ *       @c thp such buffers are not backed by huge pages and are skipped.
+ *       Buffers are aligned to the page size of @p buf_backing if they are
+ *       not smaller than it. Buffers are touched before registration, so
+ *       registration time does not include allocation of pages. Receive WRs
+ *       refer to the buffers in round-robin order, and each next WR
+ *       referring to a buffer uses the next @c BUF_SIZE slot of it, so the
+ *       device accesses all pages of all buffers. Each buffer is placed to
+ *       its own mapping, so it occupies at least one page of
+ *       @p buf_backing. Touch, registration and deregistration time is
+ *       measured on the agent.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/buf_backing"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+#include "te_mi_log.h"
+
+#define BUF_SIZE 2048
+/** Timeout of waiting for completions of one burst, in milliseconds */
+#define BURST_TIMEOUT 1000
+/** Pattern the buffers are filled with to touch them */
+#define TOUCH_PATTERN 0xa5
+/** Number of bytes in gigabyte */
+#define GB_SIZE (1ULL << 30)
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+    rcf_rpc_server     *pco_iut_buf = NULL;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        iut_fx;
+    ibvts_qp_fixture        tst_fx;
+    ibvts_buf_pool          tst_pool;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+
+    rpc_ptr                *iut_bufs = NULL;
+    struct rpc_ibv_mr     **iut_mrs = NULL;
+
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    union rpc_ibv_gid       mgid;
+    te_bool                 attached = FALSE;
+
+    struct rpc_ibv_sge     *recv_sge = NULL;
+    int                    *buf_slot = NULL;
+    int                     slot_num;
+    struct rpc_ibv_sge      send_sge;
+    struct rpc_ibv_recv_wr *iut_wr = NULL;
+    struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr *tst_wr = NULL;
+    struct rpc_ibv_send_wr *tst_bad_wr = NULL;
+    struct rpc_ibv_wc      *wc = NULL;
+
+    ibvts_buf_backing       buf_backing;
+    int                     buf_size_kb;
+    int                     buf_num = 0;
+    int                     frame_len;
+    int                     burst;
+    int                     duration;
+    size_t                  buf_size;
+    size_t                  page_size;
+    size_t                  align;
+    double                  total_gb;
+    uint64_t                usage_before;
+    uint64_t                usage_after;
+    uint64_t                usage_min;
+
+    struct timeval          tv_start;
+    struct timeval          tv_now;
+    uint64_t                elapsed = 0;
+    uint64_t                touch_time = 0;
+    uint64_t                reg_time = 0;
+    uint64_t                dereg_time = 0;
+
+    uint64_t                tx_pkts = 0;
+    uint64_t                rx_pkts = 0;
+    int                     rx_posted = 0;
+    int                     next_buf = 0;
+    int                     num;
+    int                     got;
+    int                     i;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_BUF_BACKING_PARAM(buf_backing);
+    TEST_GET_INT_PARAM(buf_size_kb);
+    TEST_GET_INT_PARAM(buf_num);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_INT_PARAM(burst);
+    TEST_GET_INT_PARAM(duration);
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+    if (buf_size_kb * 1024LL < BUF_SIZE || buf_num <= 0)
+        TEST_FAIL("Incorrect value of 'buf_size_kb' or 'buf_num' "
+                  "parameter");
+
+    buf_size = (size_t)buf_size_kb * 1024;
+    page_size = ibvts_buf_backing_page_size(buf_backing);
+    align = buf_size >= page_size ? page_size : TEST_PAGE_SIZE;
+    slot_num = buf_size / BUF_SIZE;
+    total_gb = (double)buf_size * buf_num / GB_SIZE;
+
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&iut_fx, 0, sizeof(iut_fx));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&tst_pool, 0, sizeof(tst_pool));
+
+    iut_bufs = tapi_calloc(buf_num, sizeof(*iut_bufs));
+    iut_mrs = tapi_calloc(buf_num, sizeof(*iut_mrs));
+    recv_sge = tapi_calloc(burst, sizeof(*recv_sge));
+    buf_slot = tapi_calloc(buf_num, sizeof(*buf_slot));
+    iut_wr = tapi_calloc(burst, sizeof(*iut_wr));
+    tst_wr = tapi_calloc(burst, sizeof(*tst_wr));
+    wc = tapi_calloc(burst, sizeof(*wc));
+
+    TEST_STEP("Create RPC server @p pco_iut_buf in a new process on IUT "
+              "allocating buffers backed by pages according to "
+              "@p buf_backing.");
+    CREATE_BUF_BACKING_PCO(pco_iut, buf_backing, "pco_iut_buf",
+                           pco_iut_buf);
+
+    TEST_STEP("Create device context, protection domain, completion "
+              "queues and @c IBV_QPT_RAW_PACKET QP on @p pco_iut_buf and "
+              "the same set of resources with @p sq_sig_all set to @c 1 "
+              "on @p pco_tst.");
+    CHECK_RC(ibvts_qp_fixture_create(pco_iut_buf, &fx_desc, &iut_fx));
+    fx_desc.sq_sig_all = TRUE;
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+    if (burst > iut_fx.pool_size || burst > tst_fx.pool_size)
+        TEST_FAIL("'burst' parameter exceeds the queue size supported "
+                  "by device");
+
+    TEST_STEP("Attach QP on IUT to multicast group according to "
+              "@p mcast_addr.");
+    ibvts_fill_gid(mcast_addr, &mgid);
+    rpc_ibv_attach_mcast(pco_iut_buf, iut_fx.qp->qp, &mgid, 0);
+    attached = TRUE;
+
+    TEST_STEP("Allocate @p buf_num buffers of @p buf_size_kb kilobytes on "
+              "@p pco_iut_buf and touch them by filling with a pattern. "
+              "Skip the iteration if allocation fails.");
+    CHECK_RC(ibvts_buf_backing_usage(pco_iut_buf, buf_backing,
+                                     &usage_before));
+    for (i = 0; i < buf_num; i++)
+    {
+        RPC_AWAIT_IUT_ERROR(pco_iut_buf);
+        iut_bufs[i] = rpc_memalign(pco_iut_buf, align, buf_size);
+        if (iut_bufs[i] == RPC_NULL)
+            TEST_SKIP("Failed to allocate %d buffers of %d KB on IUT",
+                      buf_num, buf_size_kb);
+        rpc_set_buf_pattern(pco_iut_buf, TOUCH_PATTERN, iut_bufs[i],
+                            buf_size);
+        touch_time += pco_iut_buf->duration;
+    }
+
+    TEST_STEP("Check that memory backed by pages of @p buf_backing has "
+              "grown at least by the size of whole pages of the buffers, "
+              "skip the iteration otherwise.");
+    CHECK_RC(ibvts_buf_backing_usage(pco_iut_buf, buf_backing,
+                                     &usage_after));
+    if (buf_backing != IBVTS_BUF_BACKING_4K)
+    {
+        usage_min = (uint64_t)buf_num * MAX(buf_size / page_size, 1) *
+                    page_size;
+        if (usage_after < usage_before + usage_min)
+        {
+            TEST_SKIP("Buffers are not backed by %s pages: %" PRIu64
+                      " bytes of such pages are used by them, %" PRIu64
+                      " bytes are expected",
+                      ibvts_buf_backing2str(buf_backing),
+                      usage_after - MIN(usage_before, usage_after),
+                      usage_min);
+        }
+    }
+
+    TEST_STEP("Register each buffer as a memory region measuring time "
+              "spent inside @b ibv_reg_mr().");
+    for (i = 0; i < buf_num; i++)
+    {
+        iut_mrs[i] = rpc_ibv_reg_mr(pco_iut_buf, iut_fx.pd, iut_bufs[i],
+                                    buf_size, IBV_ACCESS_LOCAL_WRITE);
+        reg_time += pco_iut_buf->duration;
+    }
+
+    TEST_STEP("Create a buffer on @p pco_tst with raw multicast packet of "
+              "@p frame_len length and prepare list of @p burst send WRs "
+              "referring to it.");
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+    pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                       mcast_addr, 0, TRUE, tx_buf,
+                                       frame_len - sizeof(te_eth_ip_udp_hdr),
+                                       packet);
+    ibvts_buf_pool_create(pco_tst, tst_fx.pd, 1, TEST_PAGE_SIZE, BUF_SIZE,
+                          IBV_ACCESS_LOCAL_WRITE, &tst_pool);
+    ibvts_buf_pool_write(&tst_pool, 0, packet, (size_t)pkt_len);
+    ibvts_buf_pool_sge(&tst_pool, 0, pkt_len, &send_sge);
+    for (i = 0; i < burst; i++)
+    {
+        tst_wr[i].next = (i == burst - 1) ? NULL : &tst_wr[i + 1];
+        tst_wr[i].sg_list = &send_sge;
+        tst_wr[i].num_sge = 1;
+        tst_wr[i].opcode = IBV_WR_SEND;
+        tst_wr[i].send_flags = IBV_SEND_IP_CSUM;
+        tst_wr[i].wr_id = i;
+    }
+
+    TEST_STEP("During @p duration seconds repeat: refill receive queue on "
+              "IUT up to @p burst WRs referring to the next buffers in "
+              "round-robin order, each at the next slot of the buffer, "
+              "post @p burst send WRs on Tester, wait "
+              "for their completions and for receive completions on "
+              "IUT.");
+    ibvts_rpcs_set_silent(pco_iut_buf, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    gettimeofday(&tv_start, NULL);
+    do {
+        num = burst - rx_posted;
+        if (num > 0)
+        {
+            for (i = 0; i < num; i++)
+            {
+                recv_sge[i].addr = iut_bufs[next_buf];
+                recv_sge[i].offset = (size_t)buf_slot[next_buf] * BUF_SIZE;
+                recv_sge[i].length = BUF_SIZE;
+                recv_sge[i].lkey = iut_mrs[next_buf]->lkey;
+                buf_slot[next_buf] = (buf_slot[next_buf] + 1) % slot_num;
+
+                iut_wr[i].next = (i == num - 1) ? NULL : &iut_wr[i + 1];
+                iut_wr[i].sg_list = &recv_sge[i];
+                iut_wr[i].num_sge = 1;
+                iut_wr[i].wr_id = next_buf;
+                next_buf = (next_buf + 1) % buf_num;
+            }
+            rpc_ibv_post_recv(pco_iut_buf, iut_fx.qp->qp, iut_wr,
+                              &iut_bad_wr);
+            rx_posted = burst;
+        }
+
+        rpc_ibv_post_send(pco_tst, tst_fx.qp->qp, tst_wr, &tst_bad_wr);
+        got = ibvts_poll_cq_wait(pco_tst, tst_fx.scq, burst, BURST_TIMEOUT,
+                                 FALSE, wc, NULL);
+        if (!ibvts_check_wc(wc, got, NULL))
+            TEST_VERDICT("Send WR completed with error");
+        if (got != burst)
+            TEST_VERDICT("Not all send WRs were completed");
+        tx_pkts += got;
+
+        got = ibvts_poll_cq_wait(pco_iut_buf, iut_fx.rcq, burst,
+                                 BURST_TIMEOUT, FALSE, wc, NULL);
+        if (!ibvts_check_wc(wc, got, NULL))
+            TEST_VERDICT("Receive WR completed with error");
+        rx_pkts += got;
+        rx_posted -= got;
+
+        gettimeofday(&tv_now, NULL);
+        elapsed = TIMEVAL_SUB(tv_now, tv_start);
+    } while (elapsed < (uint64_t)TE_SEC2US(duration));
+    ibvts_rpcs_set_silent(pco_iut_buf, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+
+    TEST_STEP("Deregister memory regions measuring time spent inside "
+              "@b ibv_dereg_mr().");
+    for (i = 0; i < buf_num; i++)
+    {
+        rpc_ibv_dereg_mr(pco_iut_buf, iut_mrs[i]);
+        dereg_time += pco_iut_buf->duration;
+        iut_mrs[i] = NULL;
+    }
+
+    TEST_STEP("Report time of touching, registration and deregistration "
+              "per buffer and per gigabyte and receive packet rate.");
+    RING("%d buffers of %d KB backed by %s pages: touch took %" PRIu64
+         " us, registration %" PRIu64 " us, deregistration %" PRIu64
+         " us; sent %" PRIu64 " packets, received %" PRIu64 " packets in "
+         "%" PRIu64 " us", buf_num, buf_size_kb,
+         ibvts_buf_backing2str(buf_backing), touch_time, reg_time,
+         dereg_time, tx_pkts, rx_pkts, elapsed);
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_meas_key(logger, NULL, "buf_backing", "%s",
+                              ibvts_buf_backing2str(buf_backing));
+    te_mi_logger_add_meas_key(logger, NULL, "buf_size_kb", "%d",
+                              buf_size_kb);
+    te_mi_logger_add_meas_key(logger, NULL, "buf_num", "%d", buf_num);
+    te_mi_logger_add_meas_key(logger, NULL, "frame_len", "%d", frame_len);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY, "touch_per_gb",
+                          TE_MI_MEAS_AGGR_MEAN, touch_time / total_gb,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY, "reg_per_buf",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          (double)reg_time / buf_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY, "reg_per_gb",
+                          TE_MI_MEAS_AGGR_MEAN, reg_time / total_gb,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "dereg_per_buf", TE_MI_MEAS_AGGR_MEAN,
+                          (double)dereg_time / buf_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          rx_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_THROUGHPUT, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          rx_pkts * pkt_len * 8 * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    if (rx_pkts < tx_pkts)
+        RING_VERDICT("Some packets were lost");
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    if (pco_iut_buf != NULL)
+    {
+        if (attached)
+            rpc_ibv_detach_mcast(pco_iut_buf, iut_fx.qp->qp, &mgid, 0);
+        for (i = 0; iut_mrs != NULL && i < buf_num; i++)
+        {
+            if (iut_mrs[i] != NULL)
+                rpc_ibv_dereg_mr(pco_iut_buf, iut_mrs[i]);
+        }
+        for (i = 0; iut_bufs != NULL && i < buf_num; i++)
+            rpc_free(pco_iut_buf, iut_bufs[i]);
+        ibvts_qp_fixture_destroy(&iut_fx);
+        CLEANUP_CHECK_RC(rcf_rpc_server_destroy(pco_iut_buf));
+    }
+    ibvts_buf_pool_destroy(&tst_pool);
+    ibvts_qp_fixture_destroy(&tst_fx);
+    free(tx_buf);
+    free(iut_bufs);
+    free(iut_mrs);
+    free(recv_sge);
+    free(buf_slot);
+    free(iut_wr);
+    free(tst_wr);
+    free(wc);
+
+    TEST_END;
+}
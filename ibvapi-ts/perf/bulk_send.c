@@ -0,0 +1,409 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-bulk_send Software segmented bulk send baseline
+ *
+ * @objective Measure throughput and CPU cost per byte of sending large
+ *            messages split to segments in software on
+ *            @c IBV_QPT_RAW_PACKET QP and check size and order of the
+ *            segments on receiver.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param msg_len            Length of message payload
+ * @param mss                Maximum length of payload of a segment
+ * @param gather             If @c TRUE, headers of a segment are sent
+ *                           from a separate buffer referred by the first
+ *                           SGE, otherwise each segment is a single
+ *                           pre-built frame
+ * @param duration           Duration of traffic in seconds
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note Only software segmentation is measured: @c IBV_WR_TSO is not
+ *       available via RPC, so sending with device segmentation and its
+ *       comparison with this baseline are not covered. Results are
+ *       published with MI key @c segmentation set to @c software and a
+ *       comment saying that they are a software-only baseline, not the
+ *       TSO comparison.
+ *
+ * @note Headers of each segment are made from the same
+ *       template, only ip id (sequence number of the segment) and lengths
+ *       differ. Segments of a message are posted by one call of
+ *       @b ibv_post_send() and only the last one is signaled. CPU time
+ *       is got by @b getrusage() for the whole RPC server, so it includes
+ *       RPC processing.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/bulk_send"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+#include "te_mi_log.h"
+
+#define BUF_SIZE 2048
+/** Timeout of waiting for completions of one message, in milliseconds */
+#define MSG_TIMEOUT 1000
+
+/**
+ * Check that received segment has expected headers and payload.
+ *
+ * @param rpcs      RPC server handler
+ * @param sge       SGE of receive buffer
+ * @param seg       Index of the segment in the message
+ * @param exp       Expected frame
+ * @param len       Length of @p exp
+ *
+ * @return @c TRUE if the segment is correct.
+ */
+static te_bool
+check_segment(rcf_rpc_server *rpcs, const struct rpc_ibv_sge *sge,
+              int seg, const uint8_t *exp, int len)
+{
+    uint8_t             buf[BUF_SIZE];
+    te_eth_ip_udp_hdr  *hdr = (te_eth_ip_udp_hdr *)buf;
+    uint16_t            id;
+
+    if (ibvts_read_sge_data(rpcs, sge, 1, 0, len, buf) != (size_t)len)
+    {
+        ERROR("Failed to read segment %d", seg);
+        return FALSE;
+    }
+
+    memcpy(&id, &hdr->iphdr.id, sizeof(id));
+    if (id != (uint16_t)seg)
+    {
+        ERROR("Segment %d is received instead of segment %d", id, seg);
+        return FALSE;
+    }
+    if (memcmp(buf, exp, len) != 0)
+    {
+        ERROR("Segment %d differs from the sent one", seg);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        iut_fx;
+    ibvts_qp_fixture        tst_fx;
+    ibvts_buf_pool          iut_pool;
+    ibvts_buf_pool          tst_pool;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+
+    char                   *tx_buf = NULL;
+    uint8_t               **frames = NULL;
+    int                    *frame_lens = NULL;
+    int                     hdr_len = sizeof(te_eth_ip_udp_hdr);
+
+    union rpc_ibv_gid       mgid;
+
+    struct rpc_ibv_sge     *recv_sge = NULL;
+    struct rpc_ibv_sge     *send_sge = NULL;
+    struct rpc_ibv_recv_wr *iut_wr = NULL;
+    struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr *tst_wr = NULL;
+    struct rpc_ibv_send_wr *tst_bad_wr = NULL;
+    struct rpc_ibv_wc      *wc = NULL;
+
+    int                     msg_len;
+    int                     mss;
+    te_bool                 gather;
+    int                     duration;
+    ibvts_buf_backing       buf_backing;
+    int                     seg_num = 0;
+    int                     sge_per_wr;
+    int                     seg_len;
+
+    struct timeval          tv_start;
+    struct timeval          tv_now;
+    uint64_t                elapsed = 0;
+    uint64_t                post_send_time = 0;
+    tarpc_rusage            tst_ru_start;
+    tarpc_rusage            tst_ru_end;
+    uint64_t                tst_cpu_time;
+
+    uint64_t                msgs = 0;
+    uint64_t                bytes;
+    int                     got;
+    int                     i;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_INT_PARAM(msg_len);
+    TEST_GET_INT_PARAM(mss);
+    TEST_GET_BOOL_PARAM(gather);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (mss <= 0 || hdr_len + mss > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'mss' parameter");
+    if (msg_len <= 0)
+        TEST_FAIL("Incorrect value of 'msg_len' parameter");
+
+    seg_num = (msg_len + mss - 1) / mss;
+    sge_per_wr = gather ? 2 : 1;
+
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&iut_fx, 0, sizeof(iut_fx));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&iut_pool, 0, sizeof(iut_pool));
+    memset(&tst_pool, 0, sizeof(tst_pool));
+
+    frames = tapi_calloc(seg_num, sizeof(*frames));
+    frame_lens = tapi_calloc(seg_num, sizeof(*frame_lens));
+    recv_sge = tapi_calloc(seg_num, sizeof(*recv_sge));
+    send_sge = tapi_calloc(seg_num * sge_per_wr, sizeof(*send_sge));
+    iut_wr = tapi_calloc(seg_num, sizeof(*iut_wr));
+    tst_wr = tapi_calloc(seg_num, sizeof(*tst_wr));
+    wc = tapi_calloc(seg_num, sizeof(*wc));
+
+    TEST_STEP("Create device context, protection domain, completion "
+              "queues and @c IBV_QPT_RAW_PACKET QP @p iut_qp on "
+              "@p pco_iut and the same set of resources with @c 2 send "
+              "SGEs if @p gather is @c TRUE for @p tst_qp on @p pco_tst. "
+              "Check that all segments of a message fit to the queues.");
+    fx_desc.max_send_sge = sge_per_wr;
+    fx_desc.max_recv_sge = 1;
+    CHECK_RC(ibvts_qp_fixture_create(pco_iut, &fx_desc, &iut_fx));
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+    if (seg_num > iut_fx.pool_size || seg_num > tst_fx.pool_size)
+        TEST_SKIP("Number of segments of a message exceeds the queue size "
+                  "supported by device");
+
+    TEST_STEP("Attach @p iut_qp to multicast group according to "
+              "@p mcast_addr.");
+    ibvts_fill_gid(mcast_addr, &mgid);
+    rpc_ibv_attach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_STEP("Split message of @p msg_len bytes to segments of @p mss "
+              "bytes and make a raw multicast frame of each segment with "
+              "its index as ip id.");
+    tx_buf = te_make_buf_by_len(msg_len);
+    te_fill_buf(tx_buf, msg_len);
+    for (i = 0; i < seg_num; i++)
+    {
+        seg_len = MIN(mss, msg_len - i * mss);
+        frames[i] = tapi_malloc(hdr_len + seg_len);
+        frame_lens[i] = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr,
+                                                 tst_addr, mcast_addr, i,
+                                                 TRUE, tx_buf + i * mss,
+                                                 seg_len, frames[i]);
+    }
+
+    TEST_STEP("Allocate and register a receive buffer for each segment on "
+              "@p pco_iut. Allocate and register a buffer for each segment "
+              "on @p pco_tst, if @p gather is @c TRUE - separate buffers "
+              "for headers and payload, and write segments to them.");
+    ibvts_buf_pool_create(pco_iut, iut_fx.pd, seg_num, TEST_PAGE_SIZE,
+                          BUF_SIZE, IBV_ACCESS_LOCAL_WRITE, &iut_pool);
+    ibvts_buf_pool_create(pco_tst, tst_fx.pd, seg_num * sge_per_wr,
+                          TEST_PAGE_SIZE, BUF_SIZE, IBV_ACCESS_LOCAL_WRITE,
+                          &tst_pool);
+    for (i = 0; i < seg_num; i++)
+    {
+        ibvts_buf_pool_sge(&iut_pool, i, BUF_SIZE, &recv_sge[i]);
+        if (gather)
+        {
+            ibvts_buf_pool_write(&tst_pool, 2 * i, frames[i], hdr_len);
+            ibvts_buf_pool_write(&tst_pool, 2 * i + 1, frames[i] + hdr_len,
+                                 frame_lens[i] - hdr_len);
+            ibvts_buf_pool_sge(&tst_pool, 2 * i, hdr_len,
+                               &send_sge[2 * i]);
+            ibvts_buf_pool_sge(&tst_pool, 2 * i + 1,
+                               frame_lens[i] - hdr_len,
+                               &send_sge[2 * i + 1]);
+        }
+        else
+        {
+            ibvts_buf_pool_write(&tst_pool, i, frames[i], frame_lens[i]);
+            ibvts_buf_pool_sge(&tst_pool, i, frame_lens[i], &send_sge[i]);
+        }
+    }
+
+    TEST_STEP("Prepare list of send WRs on @p pco_tst, one WR per segment "
+              "with only the last one signaled, and list of receive WRs "
+              "on @p pco_iut, one WR per segment.");
+    for (i = 0; i < seg_num; i++)
+    {
+        iut_wr[i].next = (i == seg_num - 1) ? NULL : &iut_wr[i + 1];
+        iut_wr[i].sg_list = &recv_sge[i];
+        iut_wr[i].num_sge = 1;
+        iut_wr[i].wr_id = i;
+
+        tst_wr[i].next = (i == seg_num - 1) ? NULL : &tst_wr[i + 1];
+        tst_wr[i].sg_list = &send_sge[i * sge_per_wr];
+        tst_wr[i].num_sge = sge_per_wr;
+        tst_wr[i].opcode = IBV_WR_SEND;
+        tst_wr[i].send_flags = IBV_SEND_IP_CSUM;
+        if (i == seg_num - 1)
+            tst_wr[i].send_flags |= IBV_SEND_SIGNALED;
+        tst_wr[i].wr_id = i;
+    }
+
+    TEST_STEP("Get resource usage of @p pco_tst process.");
+    rpc_getrusage(pco_tst, RPC_RUSAGE_SELF, &tst_ru_start);
+
+    TEST_STEP("During @p duration seconds repeat:");
+    ibvts_rpcs_set_silent(pco_iut, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    gettimeofday(&tv_start, NULL);
+    do {
+        TEST_SUBSTEP("Post receive WRs for all segments of a message on "
+                     "@p iut_qp, post send WRs of all segments on "
+                     "@p tst_qp and wait for completion of the last one.");
+        rpc_ibv_post_recv(pco_iut, iut_fx.qp->qp, iut_wr, &iut_bad_wr);
+        rpc_ibv_post_send(pco_tst, tst_fx.qp->qp, tst_wr, &tst_bad_wr);
+        post_send_time += pco_tst->duration;
+
+        got = ibvts_poll_cq_wait(pco_tst, tst_fx.scq, 1, MSG_TIMEOUT, FALSE,
+                                 wc, NULL);
+        if (got != 1)
+            TEST_VERDICT("Send of message was not completed");
+        if (wc[0].status != IBV_WC_SUCCESS)
+        {
+            ERROR("Send WR completed with status %d", wc[0].status);
+            TEST_VERDICT("Send WR completed with error");
+        }
+
+        TEST_SUBSTEP("Wait for receive completions of all segments and "
+                     "check that segments are received in order and have "
+                     "expected size. For the first message check also "
+                     "headers and payload of each segment.");
+        got = ibvts_poll_cq_wait(pco_iut, iut_fx.rcq, seg_num, MSG_TIMEOUT,
+                                 FALSE, wc, NULL);
+        if (got != seg_num)
+            TEST_VERDICT("Not all segments of a message were received");
+        for (i = 0; i < got; i++)
+        {
+            if (wc[i].status != IBV_WC_SUCCESS)
+            {
+                ERROR("Receive WR completed with status %d",
+                      wc[i].status);
+                TEST_VERDICT("Receive WR completed with error");
+            }
+            if (wc[i].wr_id != (uint64_t)i ||
+                wc[i].byte_len < (uint32_t)frame_lens[i])
+            {
+                ERROR("Completion %d: wr_id %llu, byte_len %u, expected "
+                      "length %d", i, (unsigned long long)wc[i].wr_id,
+                      wc[i].byte_len, frame_lens[i]);
+                TEST_VERDICT("Segment of unexpected size was received");
+            }
+            if (msgs == 0 &&
+                !check_segment(pco_iut, &recv_sge[i], i, frames[i],
+                               frame_lens[i]))
+            {
+                TEST_VERDICT("Segments were received corrupted or out of "
+                             "order");
+            }
+        }
+        msgs++;
+
+        gettimeofday(&tv_now, NULL);
+        elapsed = TIMEVAL_SUB(tv_now, tv_start);
+    } while (elapsed < (uint64_t)TE_SEC2US(duration));
+    ibvts_rpcs_set_silent(pco_iut, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+
+    rpc_getrusage(pco_tst, RPC_RUSAGE_SELF, &tst_ru_end);
+    tst_cpu_time = ibvts_rusage_cpu_time(&tst_ru_start, &tst_ru_end);
+
+    TEST_STEP("Report message rate, payload throughput, time spent inside "
+              "@b ibv_post_send() per message and CPU time of @p pco_tst "
+              "per byte of payload.");
+    bytes = msgs * msg_len;
+    RING("Sent %" PRIu64 " messages of %d segments in %" PRIu64 " us, "
+         "ibv_post_send() took %" PRIu64 " us, CPU time on Tester %"
+         PRIu64 " us", msgs, seg_num, elapsed, post_send_time,
+         tst_cpu_time);
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_comment(logger, NULL, "baseline",
+                             "software-only segmentation baseline, "
+                             "not a comparison with TSO: IBV_WR_TSO is "
+                             "not available via RPC");
+    te_mi_logger_add_meas_key(logger, NULL, "segmentation", "%s",
+                              "software");
+    te_mi_logger_add_meas_key(logger, NULL, "msg_len", "%d", msg_len);
+    te_mi_logger_add_meas_key(logger, NULL, "mss", "%d", mss);
+    te_mi_logger_add_meas_key(logger, NULL, "gather", "%s",
+                              gather ? "TRUE" : "FALSE");
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "msg",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          msgs * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "seg",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          msgs * seg_num * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_THROUGHPUT, "payload",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          bytes * 8 * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "post_send_per_msg", TE_MI_MEAS_AGGR_MEAN,
+                          (double)post_send_time / msgs,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "tst_cpu_per_byte", TE_MI_MEAS_AGGR_MEAN,
+                          tst_cpu_time * 1000.0 / bytes,
+                          TE_MI_MEAS_MULTIPLIER_NANO);
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    TEST_STEP("Free all allocated resources.");
+    rpc_ibv_detach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    ibvts_buf_pool_destroy(&iut_pool);
+    ibvts_buf_pool_destroy(&tst_pool);
+    ibvts_qp_fixture_destroy(&iut_fx);
+    ibvts_qp_fixture_destroy(&tst_fx);
+    for (i = 0; frames != NULL && i < seg_num; i++)
+        free(frames[i]);
+    free(frames);
+    free(frame_lens);
+    free(tx_buf);
+    free(recv_sge);
+    free(send_sge);
+    free(iut_wr);
+    free(tst_wr);
+    free(wc);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
@@ -0,0 +1,515 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-comp_vector Spreading of receive completions over completion vectors
+ *
+ * @objective Measure how receive packet rate scales with number of
+ *            completion vectors used by CQs and check that completion
+ *            events are delivered for each of the vectors.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address, address of multicast
+ *                           group of each next QP is incremented by 1
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param vector_num         Number of completion vectors to be used
+ * @param burst              Number of packets sent to each QP in a round
+ * @param duration           Duration of traffic in seconds
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note Each vector is served by a separate thread of RPC server on IUT
+ *       bound to its own CPU. Completion events are waited for and
+ *       receive CQs are polled by non-blocking RPC calls started in all
+ *       threads before waiting for their results, so the threads work
+ *       in parallel.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/comp_vector"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+
+#define BUF_SIZE 2048
+/** Timeout of waiting for completions of one round, in milliseconds */
+#define ROUND_TIMEOUT 1000
+/** Maximum number of send WRs posted by one call */
+#define TX_CHUNK 256
+/** Number of CPUs in affinity mask */
+#define CPU_MAX 1024
+/** Number of words in affinity mask */
+#define CPU_MASK_WORDS (CPU_MAX / (8 * sizeof(unsigned long)))
+
+/**
+ * Bind RPC server thread to a CPU.
+ *
+ * @param rpcs  RPC server thread
+ * @param cpu   CPU number
+ */
+static void
+bind_to_cpu(rcf_rpc_server *rpcs, int cpu)
+{
+    unsigned long mask[CPU_MASK_WORDS];
+
+    memset(mask, 0, sizeof(mask));
+    mask[cpu / (8 * sizeof(unsigned long))] |=
+        1UL << (cpu % (8 * sizeof(unsigned long)));
+    rpc_sched_setaffinity(rpcs, 0, sizeof(mask), mask);
+}
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+    rcf_rpc_server    **iut_thr = NULL;
+    char                thr_name[RCF_MAX_NAME];
+    unsigned long       cpu_mask[CPU_MASK_WORDS];
+    int                 cpu;
+
+    struct rpc_ibv_context       *iut_context = NULL;
+    int                           iut_ibv_port = 0;
+    struct rpc_ibv_device_attr    attr;
+    rpc_ptr                       iut_pd = RPC_NULL;
+    struct rpc_ibv_mr            *iut_mr = NULL;
+    rpc_ptr                       iut_scq = RPC_NULL;
+    struct rpc_ibv_comp_channel **iut_ev_ch = NULL;
+    rpc_ptr                      *iut_rcq = NULL;
+    struct rpc_ibv_qp           **iut_qp = NULL;
+    union rpc_ibv_gid            *mgid = NULL;
+    struct rpc_ibv_qp_init_attr   qp_attr;
+    struct rpc_pollfd            *fds = NULL;
+    rpc_ptr                       ev_cq = RPC_NULL;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        tst_fx;
+    ibvts_buf_pool          tst_pool;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+    struct sockaddr_in      grp_addr;
+
+    rpc_ptr                 iut_buffer = RPC_NULL;
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    struct rpc_ibv_sge      recv_sge;
+    struct rpc_ibv_sge     *send_sge = NULL;
+    struct rpc_ibv_recv_wr *iut_wr = NULL;
+    struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr *tst_wr = NULL;
+    struct rpc_ibv_send_wr *tst_bad_wr = NULL;
+    struct rpc_ibv_wc      *wc = NULL;
+    struct rpc_ibv_wc      *cv_wc = NULL;
+
+    int                     frame_len;
+    int                     vector_num;
+    int                     burst;
+    int                     duration;
+    ibvts_buf_backing       buf_backing;
+
+    struct timeval          tv_start;
+    struct timeval          tv_now;
+    struct timeval          tv_round;
+    uint64_t                elapsed = 0;
+
+    uint64_t               *cv_pkts = NULL;
+    uint64_t               *cv_events = NULL;
+    int                    *rx_posted = NULL;
+    int                    *cv_got = NULL;
+    int                     pending;
+    uint64_t                tx_pkts = 0;
+    uint64_t                rx_pkts = 0;
+    uint64_t                min_events;
+    uint64_t                max_events;
+    uint64_t                min_pkts;
+    uint64_t                max_pkts;
+    int                     tx_num;
+    int                     chunk;
+    int                     got;
+    int                     i;
+    int                     v;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_INT_PARAM(vector_num);
+    TEST_GET_INT_PARAM(burst);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+
+    tx_num = vector_num * burst;
+
+    memset(&attr, 0, sizeof(attr));
+    memset(&qp_attr, 0, sizeof(qp_attr));
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&tst_pool, 0, sizeof(tst_pool));
+    memset(&recv_sge, 0, sizeof(recv_sge));
+
+    iut_thr = tapi_calloc(vector_num, sizeof(*iut_thr));
+    iut_ev_ch = tapi_calloc(vector_num, sizeof(*iut_ev_ch));
+    iut_rcq = tapi_calloc(vector_num, sizeof(*iut_rcq));
+    iut_qp = tapi_calloc(vector_num, sizeof(*iut_qp));
+    mgid = tapi_calloc(vector_num, sizeof(*mgid));
+    fds = tapi_calloc(vector_num, sizeof(*fds));
+    cv_pkts = tapi_calloc(vector_num, sizeof(*cv_pkts));
+    cv_events = tapi_calloc(vector_num, sizeof(*cv_events));
+    rx_posted = tapi_calloc(vector_num, sizeof(*rx_posted));
+    cv_got = tapi_calloc(vector_num, sizeof(*cv_got));
+    send_sge = tapi_calloc(vector_num, sizeof(*send_sge));
+    iut_wr = tapi_calloc(burst, sizeof(*iut_wr));
+    tst_wr = tapi_calloc(tx_num, sizeof(*tst_wr));
+    wc = tapi_calloc(MAX(tx_num, TX_CHUNK), sizeof(*wc));
+    cv_wc = tapi_calloc(tx_num, sizeof(*cv_wc));
+
+    TEST_STEP("Create device context, protection domain, send CQ and "
+              "memory region for receive buffer on @p pco_iut. Check "
+              "that the device supports @p vector_num completion "
+              "vectors.");
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+    iut_buffer = rpc_memalign(pco_iut, TEST_PAGE_SIZE, BUF_SIZE);
+
+    iut_context = rpc_ibv_open_device(pco_iut, &iut_ibv_port);
+    if (vector_num > iut_context->num_comp_vectors)
+        TEST_SKIP("IUT device supports only %d completion vectors",
+                  iut_context->num_comp_vectors);
+    iut_pd = rpc_ibv_alloc_pd(pco_iut, iut_context->context);
+    rpc_ibv_query_device(pco_iut, iut_context->context, &attr);
+    if (burst > attr.max_cqe || burst > attr.max_qp_wr)
+        TEST_FAIL("'burst' parameter exceeds the queue size supported "
+                  "by IUT device");
+
+    iut_mr = rpc_ibv_reg_mr(pco_iut, iut_pd, iut_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+    iut_scq = rpc_ibv_create_cq(pco_iut, iut_context->context, 1,
+                                RPC_NULL, RPC_NULL, 0);
+
+    TEST_STEP("For each of @p vector_num completion vectors create on "
+              "@p pco_iut: RPC server thread bound to its own CPU allowed "
+              "for @p pco_iut, completion channel, receive CQ bound to "
+              "the channel and the vector and @c IBV_QPT_RAW_PACKET QP "
+              "using the CQ. Move the QP to @c IBV_QPS_RTS state and "
+              "attach it to its own multicast group.");
+    memset(cpu_mask, 0, sizeof(cpu_mask));
+    rpc_sched_getaffinity(pco_iut, 0, sizeof(cpu_mask), cpu_mask);
+    memcpy(&grp_addr, mcast_addr, sizeof(grp_addr));
+    for (v = 0, cpu = -1; v < vector_num; v++)
+    {
+        do {
+            cpu++;
+        } while (cpu < CPU_MAX &&
+                 (cpu_mask[cpu / (8 * sizeof(unsigned long))] &
+                  (1UL << (cpu % (8 * sizeof(unsigned long))))) == 0);
+        if (cpu == CPU_MAX)
+            TEST_SKIP("IUT has less than %d CPUs allowed for RPC server",
+                      vector_num);
+
+        snprintf(thr_name, sizeof(thr_name), "iut_cv%d", v);
+        CHECK_RC(rcf_rpc_server_thread_create(pco_iut, thr_name,
+                                              &iut_thr[v]));
+        bind_to_cpu(iut_thr[v], cpu);
+
+        iut_ev_ch[v] = rpc_ibv_create_comp_channel(pco_iut,
+                                                   iut_context->context);
+        iut_rcq[v] = rpc_ibv_create_cq(pco_iut, iut_context->context, burst,
+                                       RPC_NULL, iut_ev_ch[v]->cc, v);
+
+        qp_attr.send_cq = iut_scq;
+        qp_attr.recv_cq = iut_rcq[v];
+        qp_attr.cap.max_send_wr = 1;
+        qp_attr.cap.max_recv_wr = burst;
+        qp_attr.cap.max_send_sge = 1;
+        qp_attr.cap.max_recv_sge = 1;
+        qp_attr.qp_type = IBV_QPT_RAW_PACKET;
+        iut_qp[v] = rpc_ibv_create_qp(pco_iut, iut_pd, &qp_attr);
+        ibvts_qp_to_rts(pco_iut, iut_qp[v], iut_ibv_port);
+
+        grp_addr.sin_addr.s_addr =
+            htonl(ntohl(SIN(mcast_addr)->sin_addr.s_addr) + v);
+        ibvts_fill_gid(SA(&grp_addr), &mgid[v]);
+        rpc_ibv_attach_mcast(pco_iut, iut_qp[v]->qp, &mgid[v], 0);
+
+        fds[v].fd = iut_ev_ch[v]->fd;
+        fds[v].events = RPC_POLLIN | RPC_POLLPRI | RPC_POLLERR |
+                        RPC_POLLHUP;
+    }
+
+    TEST_STEP("Create @c IBV_QPT_RAW_PACKET QP @p tst_qp with @p sq_sig_all "
+              "set to @c 1 on @p pco_tst.");
+    fx_desc.max_send_wr = MIN(tx_num, TX_CHUNK);
+    fx_desc.max_recv_wr = 1;
+    fx_desc.max_send_sge = 1;
+    fx_desc.max_recv_sge = 1;
+    fx_desc.sq_sig_all = TRUE;
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+
+    TEST_STEP("Create @p vector_num buffers on @p pco_tst and write to "
+              "each of them raw packet of @p frame_len length addressed to "
+              "multicast group of the corresponding QP on IUT.");
+    ibvts_buf_pool_create(pco_tst, tst_fx.pd, vector_num, TEST_PAGE_SIZE,
+                          BUF_SIZE, IBV_ACCESS_LOCAL_WRITE, &tst_pool);
+    for (v = 0; v < vector_num; v++)
+    {
+        grp_addr.sin_addr.s_addr =
+            htonl(ntohl(SIN(mcast_addr)->sin_addr.s_addr) + v);
+        pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                           SA(&grp_addr), 0, TRUE, tx_buf,
+                                           frame_len -
+                                           sizeof(te_eth_ip_udp_hdr),
+                                           packet);
+        ibvts_buf_pool_write(&tst_pool, v, packet, (size_t)pkt_len);
+        ibvts_buf_pool_sge(&tst_pool, v, pkt_len, &send_sge[v]);
+    }
+
+    TEST_STEP("Prepare list of @p burst * @p vector_num send WRs on "
+              "@p pco_tst addressing QPs on IUT in round-robin order and "
+              "list of @p burst receive WRs on @p pco_iut.");
+    recv_sge.addr = iut_buffer;
+    recv_sge.length = BUF_SIZE;
+    recv_sge.lkey = iut_mr->lkey;
+    for (i = 0; i < burst; i++)
+    {
+        iut_wr[i].next = (i == burst - 1) ? NULL : &iut_wr[i + 1];
+        iut_wr[i].sg_list = &recv_sge;
+        iut_wr[i].num_sge = 1;
+        iut_wr[i].wr_id = i;
+    }
+    for (i = 0; i < tx_num; i++)
+    {
+        tst_wr[i].next = ((i + 1) % TX_CHUNK == 0 || i == tx_num - 1) ?
+                         NULL : &tst_wr[i + 1];
+        tst_wr[i].sg_list = &send_sge[i % vector_num];
+        tst_wr[i].num_sge = 1;
+        tst_wr[i].opcode = IBV_WR_SEND;
+        tst_wr[i].send_flags = IBV_SEND_IP_CSUM;
+        tst_wr[i].wr_id = i;
+    }
+
+    TEST_STEP("During @p duration seconds repeat:");
+    ibvts_rpcs_set_silent(pco_iut, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    for (v = 0; v < vector_num; v++)
+        ibvts_rpcs_set_silent(iut_thr[v], TRUE);
+    gettimeofday(&tv_start, NULL);
+    do {
+        TEST_SUBSTEP("Refill receive queue of each QP on IUT up to "
+                     "@p burst WRs and request completion event on each "
+                     "receive CQ.");
+        for (v = 0; v < vector_num; v++)
+        {
+            if (rx_posted[v] < burst)
+            {
+                rpc_ibv_post_recv(pco_iut, iut_qp[v]->qp,
+                                  &iut_wr[rx_posted[v]], &iut_bad_wr);
+                rx_posted[v] = burst;
+            }
+            rpc_ibv_req_notify_cq(pco_iut, iut_rcq[v], 0);
+        }
+
+        TEST_SUBSTEP("Start @b poll() on each completion channel fd in "
+                     "its own RPC server thread without waiting for "
+                     "result.");
+        for (v = 0; v < vector_num; v++)
+        {
+            fds[v].revents = 0;
+            iut_thr[v]->op = RCF_RPC_CALL;
+            rpc_poll(iut_thr[v], &fds[v], 1, ROUND_TIMEOUT);
+        }
+
+        TEST_SUBSTEP("Post @p burst * @p vector_num send WRs on @p tst_qp "
+                     "by chunks and wait for their completions.");
+        for (i = 0; i < tx_num; i += chunk)
+        {
+            chunk = MIN(TX_CHUNK, tx_num - i);
+            rpc_ibv_post_send(pco_tst, tst_fx.qp->qp, &tst_wr[i],
+                              &tst_bad_wr);
+            got = ibvts_poll_cq_wait(pco_tst, tst_fx.scq, chunk,
+                                     ROUND_TIMEOUT, FALSE, wc, NULL);
+            if (got != chunk)
+                TEST_VERDICT("Not all send WRs were completed");
+            tx_pkts += got;
+        }
+
+        TEST_SUBSTEP("Wait for @b poll() results in all threads, get and "
+                     "acknowledge reported completion events.");
+        for (v = 0; v < vector_num; v++)
+        {
+            iut_thr[v]->op = RCF_RPC_WAIT;
+            if (rpc_poll(iut_thr[v], &fds[v], 1, ROUND_TIMEOUT) == 1)
+            {
+                rpc_ibv_get_cq_event(iut_thr[v], iut_ev_ch[v]->cc, &ev_cq,
+                                     NULL);
+                rpc_ibv_ack_cq_events(iut_thr[v], ev_cq, 1);
+                cv_events[v]++;
+            }
+            cv_got[v] = 0;
+        }
+
+        TEST_SUBSTEP("Until @p burst receive completions are got from "
+                     "each receive CQ or round timeout expires: start "
+                     "@b ibv_poll_cq() on each CQ which is not drained "
+                     "yet in its own thread without waiting for result, "
+                     "then wait for results in all the threads.");
+        gettimeofday(&tv_round, NULL);
+        do {
+            for (v = 0; v < vector_num; v++)
+            {
+                if (cv_got[v] == burst)
+                    continue;
+                iut_thr[v]->op = RCF_RPC_CALL;
+                rpc_ibv_poll_cq(iut_thr[v], iut_rcq[v], burst - cv_got[v],
+                                &cv_wc[v * burst + cv_got[v]]);
+            }
+            for (v = 0, pending = 0; v < vector_num; v++)
+            {
+                if (cv_got[v] == burst)
+                    continue;
+                iut_thr[v]->op = RCF_RPC_WAIT;
+                got = rpc_ibv_poll_cq(iut_thr[v], iut_rcq[v],
+                                      burst - cv_got[v],
+                                      &cv_wc[v * burst + cv_got[v]]);
+                if (got < 0)
+                    TEST_VERDICT("ibv_poll_cq() failed on IUT");
+                cv_got[v] += got;
+                if (cv_got[v] < burst)
+                    pending++;
+            }
+            gettimeofday(&tv_now, NULL);
+        } while (pending > 0 &&
+                 TIMEVAL_SUB(tv_now, tv_round) <= TE_MS2US(ROUND_TIMEOUT));
+
+        for (v = 0; v < vector_num; v++)
+        {
+            if (!ibvts_check_wc(&cv_wc[v * burst], cv_got[v], NULL))
+                TEST_VERDICT("Receive WR completed with error");
+            cv_pkts[v] += cv_got[v];
+            rx_posted[v] -= cv_got[v];
+            rx_pkts += cv_got[v];
+        }
+
+        gettimeofday(&tv_now, NULL);
+        elapsed = TIMEVAL_SUB(tv_now, tv_start);
+    } while (elapsed < (uint64_t)TE_SEC2US(duration));
+    ibvts_rpcs_set_silent(pco_iut, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+    for (v = 0; v < vector_num; v++)
+        ibvts_rpcs_set_silent(iut_thr[v], FALSE);
+
+    TEST_STEP("Report aggregate packet rate, minimum and maximum packet "
+              "rate and number of completion events per vector.");
+    min_pkts = max_pkts = cv_pkts[0];
+    min_events = max_events = cv_events[0];
+    for (v = 0; v < vector_num; v++)
+    {
+        RING("Completion vector %d: %" PRIu64 " packets, %" PRIu64
+             " events", v, cv_pkts[v], cv_events[v]);
+        min_pkts = MIN(min_pkts, cv_pkts[v]);
+        max_pkts = MAX(max_pkts, cv_pkts[v]);
+        min_events = MIN(min_events, cv_events[v]);
+        max_events = MAX(max_events, cv_events[v]);
+    }
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_meas_key(logger, NULL, "vector_num", "%d",
+                              vector_num);
+    te_mi_logger_add_meas_key(logger, NULL, "burst", "%d", burst);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          rx_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx_vector",
+                          TE_MI_MEAS_AGGR_MIN,
+                          min_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx_vector",
+                          TE_MI_MEAS_AGGR_MAX,
+                          max_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "events_vector",
+                          TE_MI_MEAS_AGGR_MIN,
+                          min_events * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "events_vector",
+                          TE_MI_MEAS_AGGR_MAX,
+                          max_events * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    if (min_events == 0)
+        RING_VERDICT("No completion events were got for some vectors");
+    if (rx_pkts < tx_pkts)
+        RING_VERDICT("Some packets were lost");
+
+    TEST_STEP("Free all allocated resources.");
+    for (v = 0; v < vector_num; v++)
+    {
+        rpc_ibv_detach_mcast(pco_iut, iut_qp[v]->qp, &mgid[v], 0);
+        rpc_ibv_destroy_qp(pco_iut, iut_qp[v]);
+        rpc_ibv_destroy_cq(pco_iut, iut_rcq[v]);
+        rpc_ibv_destroy_comp_channel(pco_iut, iut_ev_ch[v]);
+    }
+    rpc_ibv_destroy_cq(pco_iut, iut_scq);
+    rpc_ibv_dereg_mr(pco_iut, iut_mr);
+    rpc_ibv_dealloc_pd(pco_iut, iut_pd);
+    rpc_ibv_close_device(pco_iut, iut_context);
+
+    ibvts_buf_pool_destroy(&tst_pool);
+    ibvts_qp_fixture_destroy(&tst_fx);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    for (v = 0; iut_thr != NULL && v < vector_num; v++)
+    {
+        if (iut_thr[v] != NULL)
+            CLEANUP_CHECK_RC(rcf_rpc_server_destroy(iut_thr[v]));
+    }
+    free(tx_buf);
+    free(iut_thr);
+    free(iut_ev_ch);
+    free(iut_rcq);
+    free(iut_qp);
+    free(mgid);
+    free(fds);
+    free(cv_pkts);
+    free(cv_events);
+    free(rx_posted);
+    free(cv_got);
+    free(send_sge);
+    free(iut_wr);
+    free(tst_wr);
+    free(wc);
+    free(cv_wc);
+    rpc_free(pco_iut, iut_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
@@ -0,0 +1,426 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-compl_mode Busy polling vs event driven completions
+ *
+ * @objective Compare throughput, latency of receive completions and CPU
+ *            time consumed by RPC server on IUT when completions are got
+ *            by busy polling, by waiting for completion events or by
+ *            polling for a while before waiting for events.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param burst              Number of WRs posted by one call of
+ *                           @b ibv_post_send()/ @b ibv_post_recv()
+ * @param mode               How completions are got:
+ *                           - @c spin: call @b ibv_poll_cq() until it
+ *                             reports completions;
+ *                           - @c event: call @b ibv_poll_cq() once and,
+ *                             if it reports nothing, call
+ *                             @b ibv_req_notify_cq() (unless it is
+ *                             already called), @b poll() on completion
+ *                             channel fd and @b ibv_poll_cq() after the
+ *                             event;
+ *                           - @c hybrid: call @b ibv_poll_cq() up to
+ *                             @p spin_num times and switch to waiting
+ *                             for the event if nothing is reported.
+ * @param spin_num           Number of empty polls before waiting for
+ *                           the event in @c hybrid mode
+ * @param duration           Duration of traffic in seconds
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note CPU time is got by @b getrusage() for the whole RPC server
+ *       process on IUT and is reported as @c iut_rpc_server, not as CPU
+ *       time of an application: it includes handling of RPC calls. In
+ *       @c spin mode each poll is a separate RPC call, so the absolute
+ *       numbers are higher than for an application polling locally, but
+ *       the modes can be compared with each other. Latency of a
+ *       completion is time from posting its burst on Tester till getting
+ *       it on IUT.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/compl_mode"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+
+#define BUF_SIZE 2048
+
+/** Ways to get completions */
+typedef enum compl_mode {
+    COMPL_MODE_SPIN,    /**< Busy polling */
+    COMPL_MODE_EVENT,   /**< Waiting for completion events */
+    COMPL_MODE_HYBRID,  /**< Busy polling, then waiting for events */
+} compl_mode;
+
+/**
+ * Get completions from receive CQ of the fixture. CQ is always polled
+ * first; notification is requested only when CQ is found empty and it is
+ * not requested yet, and CQ is polled again after that, so that an event
+ * is not requested for completions which are already got.
+ *
+ * @param fx        QP fixture
+ * @param mode      How to get completions
+ * @param spin_num  Number of empty polls before waiting for the event in
+ *                  @c COMPL_MODE_HYBRID mode
+ * @param wc        Array of at least @p max entries to store
+ *                  completions (OUT)
+ * @param max       Maximum number of completions to get
+ * @param armed     Whether notification is requested and its event is
+ *                  not got yet (IN/OUT)
+ * @param polls     Where to add number of @b ibv_poll_cq() calls (OUT)
+ * @param events    Where to add number of got events (OUT)
+ *
+ * @return Number of got completions or @c -1 if nothing was got in time.
+ */
+static int
+get_compl(ibvts_qp_fixture *fx, compl_mode mode, int spin_num,
+          struct rpc_ibv_wc *wc, int max, te_bool *armed,
+          uint64_t *polls, uint64_t *events)
+{
+    rcf_rpc_server     *rpcs = fx->rpcs;
+    struct rpc_pollfd   fds;
+    rpc_ptr             ev_cq = RPC_NULL;
+    struct timeval      tv_start;
+    struct timeval      tv_now;
+    int                 spins = 0;
+    int                 got;
+
+    if (mode == COMPL_MODE_EVENT)
+        spin_num = 1;
+
+    gettimeofday(&tv_start, NULL);
+    do {
+        got = rpc_ibv_poll_cq(rpcs, fx->rcq, max, wc);
+        (*polls)++;
+        if (got > 0)
+            return got;
+        spins++;
+        gettimeofday(&tv_now, NULL);
+    } while ((mode == COMPL_MODE_SPIN || spins < spin_num) &&
+             TIMEVAL_SUB(tv_now, tv_start) < TE_MS2US(TEST_COMPL_TIMEOUT));
+
+    if (mode == COMPL_MODE_SPIN)
+        return -1;
+
+    if (!*armed)
+    {
+        rpc_ibv_req_notify_cq(rpcs, fx->rcq, 0);
+        *armed = TRUE;
+        got = rpc_ibv_poll_cq(rpcs, fx->rcq, max, wc);
+        (*polls)++;
+        if (got > 0)
+            return got;
+    }
+
+    fds.fd = fx->ev_ch->fd;
+    fds.events = RPC_POLLIN | RPC_POLLPRI | RPC_POLLERR | RPC_POLLHUP;
+    fds.revents = 0;
+    if (rpc_poll(rpcs, &fds, 1, TEST_COMPL_TIMEOUT) != 1)
+        return -1;
+    rpc_ibv_get_cq_event(rpcs, fx->ev_ch->cc, &ev_cq, NULL);
+    rpc_ibv_ack_cq_events(rpcs, ev_cq, 1);
+    *armed = FALSE;
+    (*events)++;
+
+    (*polls)++;
+    return rpc_ibv_poll_cq(rpcs, fx->rcq, max, wc);
+}
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        iut_fx;
+    ibvts_qp_fixture        tst_fx;
+    struct rpc_ibv_mr      *iut_mr = NULL;
+    struct rpc_ibv_mr      *tst_mr = NULL;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+
+    rpc_ptr                 iut_buffer = RPC_NULL;
+    rpc_ptr                 tst_buffer = RPC_NULL;
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    union rpc_ibv_gid       mgid;
+
+    struct rpc_ibv_sge      recv_sge;
+    struct rpc_ibv_sge      send_sge;
+    struct rpc_ibv_recv_wr *iut_wr = NULL;
+    struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr *tst_wr = NULL;
+    struct rpc_ibv_send_wr *tst_bad_wr = NULL;
+    struct rpc_ibv_wc      *wc = NULL;
+
+    int                     frame_len;
+    int                     burst;
+    const char             *mode;
+    compl_mode              cmode;
+    int                     spin_num;
+    int                     duration;
+    ibvts_buf_backing       buf_backing;
+
+    struct timeval          tv_start;
+    struct timeval          tv_post;
+    struct timeval          tv_now;
+    uint64_t                elapsed = 0;
+    uint64_t                lat;
+
+    uint64_t                rx_pkts = 0;
+    uint64_t                rx_bytes = 0;
+    uint64_t                events = 0;
+    uint64_t                polls = 0;
+    te_bool                 armed = FALSE;
+    uint64_t                cpu_time;
+    tarpc_rusage            ru_start;
+    tarpc_rusage            ru_end;
+    int                     rx_posted = 0;
+    int                     got;
+    int                     num;
+    int                     i;
+
+    ibvts_hist              compl_lat;
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_INT_PARAM(burst);
+    TEST_GET_STRING_PARAM(mode);
+    TEST_GET_INT_PARAM(spin_num);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+    if (strcmp(mode, "spin") == 0)
+        cmode = COMPL_MODE_SPIN;
+    else if (strcmp(mode, "event") == 0)
+        cmode = COMPL_MODE_EVENT;
+    else if (strcmp(mode, "hybrid") == 0)
+        cmode = COMPL_MODE_HYBRID;
+    else
+        TEST_FAIL("Incorrect value of 'mode' parameter");
+
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&iut_fx, 0, sizeof(iut_fx));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&recv_sge, 0, sizeof(recv_sge));
+    memset(&send_sge, 0, sizeof(send_sge));
+    memset(&ru_start, 0, sizeof(ru_start));
+    memset(&ru_end, 0, sizeof(ru_end));
+    ibvts_hist_init(&compl_lat);
+
+    TEST_STEP("Create buffers @p iut_buffer and @p tst_buffer on @p pco_iut "
+              "and @p pco_tst.");
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+
+    iut_buffer = rpc_memalign(pco_iut, TEST_PAGE_SIZE, BUF_SIZE);
+    tst_buffer = rpc_memalign(pco_tst, TEST_PAGE_SIZE, BUF_SIZE);
+
+    TEST_STEP("Create @c IBV_QPT_RAW_PACKET QP @p iut_qp with receive CQ "
+              "bound to completion channel @p iut_ev_ch on @p pco_iut and "
+              "@c IBV_QPT_RAW_PACKET QP @p tst_qp with @p sq_sig_all set "
+              "to @c 1 on @p pco_tst. Move the QPs to @c IBV_QPS_RTS "
+              "state.");
+    fx_desc.max_send_sge = 1;
+    fx_desc.max_recv_sge = 1;
+    fx_desc.comp_channel = TRUE;
+    CHECK_RC(ibvts_qp_fixture_create(pco_iut, &fx_desc, &iut_fx));
+    fx_desc.comp_channel = FALSE;
+    fx_desc.sq_sig_all = TRUE;
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+    if (burst > iut_fx.pool_size || burst > tst_fx.pool_size)
+        TEST_FAIL("'burst' parameter exceeds the queue size supported "
+                  "by device");
+
+    TEST_STEP("Create memory regions for @p iut_buffer and @p tst_buffer.");
+    iut_mr = rpc_ibv_reg_mr(pco_iut, iut_fx.pd, iut_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+    tst_mr = rpc_ibv_reg_mr(pco_tst, tst_fx.pd, tst_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+
+    TEST_STEP("Attach @p iut_qp to multicast group according to "
+              "@p mcast_addr.");
+    ibvts_fill_gid(mcast_addr, &mgid);
+    rpc_ibv_attach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_STEP("Create raw multicast packet of @p frame_len length and write "
+              "it to @p tst_buffer.");
+    pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                       mcast_addr, 0, TRUE, tx_buf,
+                                       frame_len - sizeof(te_eth_ip_udp_hdr),
+                                       packet);
+    rpc_set_buf_gen(pco_tst, packet, (size_t)pkt_len, tst_buffer, 0);
+
+    TEST_STEP("Prepare lists of @p burst send WRs on @p pco_tst and receive "
+              "WRs on @p pco_iut.");
+    iut_wr = tapi_calloc(burst, sizeof(*iut_wr));
+    tst_wr = tapi_calloc(burst, sizeof(*tst_wr));
+    wc = tapi_calloc(burst, sizeof(*wc));
+
+    recv_sge.addr = iut_buffer;
+    recv_sge.length = BUF_SIZE;
+    recv_sge.lkey = iut_mr->lkey;
+
+    send_sge.addr = tst_buffer;
+    send_sge.length = pkt_len;
+    send_sge.lkey = tst_mr->lkey;
+
+    for (i = 0; i < burst; i++)
+    {
+        iut_wr[i].next = (i == burst - 1) ? NULL : &iut_wr[i + 1];
+        iut_wr[i].sg_list = &recv_sge;
+        iut_wr[i].num_sge = 1;
+        iut_wr[i].wr_id = i;
+
+        tst_wr[i].next = (i == burst - 1) ? NULL : &tst_wr[i + 1];
+        tst_wr[i].sg_list = &send_sge;
+        tst_wr[i].num_sge = 1;
+        tst_wr[i].opcode = IBV_WR_SEND;
+        tst_wr[i].send_flags = IBV_SEND_IP_CSUM;
+        tst_wr[i].wr_id = i;
+    }
+
+    TEST_STEP("Get resource usage of @p pco_iut process.");
+    rpc_getrusage(pco_iut, RPC_RUSAGE_SELF, &ru_start);
+
+    TEST_STEP("During @p duration seconds repeat:");
+    ibvts_rpcs_set_silent(pco_iut, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    gettimeofday(&tv_start, NULL);
+    do {
+        TEST_SUBSTEP("Refill receive queue of @p iut_qp up to @p burst WRs "
+                     "and post @p burst send WRs on @p tst_qp.");
+        if (rx_posted < burst)
+        {
+            rpc_ibv_post_recv(pco_iut, iut_fx.qp->qp,
+                              &iut_wr[rx_posted], &iut_bad_wr);
+            rx_posted = burst;
+        }
+        gettimeofday(&tv_post, NULL);
+        rpc_ibv_post_send(pco_tst, tst_fx.qp->qp, tst_wr, &tst_bad_wr);
+
+        TEST_SUBSTEP("Until all @p burst receive completions are got, "
+                     "get completions from @p iut_rcq according to "
+                     "@p mode. Add time passed since posting the burst "
+                     "to latency histogram for each got completion.");
+        for (got = 0; got < burst; got += num)
+        {
+            num = get_compl(&iut_fx, cmode, spin_num, wc, burst - got,
+                            &armed, &polls, &events);
+            if (num < 0)
+                TEST_VERDICT("Receive completions were not got on IUT");
+
+            gettimeofday(&tv_now, NULL);
+            lat = TIMEVAL_SUB(tv_now, tv_post);
+            for (i = 0; i < num; i++)
+            {
+                if (wc[i].status != IBV_WC_SUCCESS)
+                {
+                    ERROR("Completion of WR %llu has status %d",
+                          (unsigned long long)wc[i].wr_id, wc[i].status);
+                    TEST_VERDICT("Receive WR completed with error");
+                }
+                ibvts_hist_add(&compl_lat, lat);
+                rx_bytes += wc[i].byte_len;
+            }
+        }
+        rx_pkts += got;
+        rx_posted -= got;
+
+        TEST_SUBSTEP("Get completions of send WRs on @p tst_scq.");
+        if (ibvts_poll_cq_wait(pco_tst, tst_fx.scq, burst,
+                               TEST_COMPL_TIMEOUT, FALSE, wc, NULL) != burst)
+            TEST_VERDICT("Not all send WRs were completed");
+
+        gettimeofday(&tv_now, NULL);
+        elapsed = TIMEVAL_SUB(tv_now, tv_start);
+    } while (elapsed < (uint64_t)TE_SEC2US(duration));
+    ibvts_rpcs_set_silent(pco_iut, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+
+    rpc_getrusage(pco_iut, RPC_RUSAGE_SELF, &ru_end);
+    cpu_time = ibvts_rusage_cpu_time(&ru_start, &ru_end);
+
+    TEST_STEP("Report rate of received packets and bits, distribution of "
+              "completion latency and CPU time consumed by RPC server "
+              "@p pco_iut.");
+    RING("Got %" PRIu64 " packets in %" PRIu64 " us by %" PRIu64
+         " ibv_poll_cq() calls and %" PRIu64 " completion events, "
+         "CPU time %" PRIu64 " us", rx_pkts, elapsed, polls, events,
+         cpu_time);
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_meas_key(logger, NULL, "frame_len", "%d", frame_len);
+    te_mi_logger_add_meas_key(logger, NULL, "burst", "%d", burst);
+    te_mi_logger_add_meas_key(logger, NULL, "mode", "%s", mode);
+    te_mi_logger_add_meas_key(logger, NULL, "spin_num", "%d", spin_num);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          rx_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_THROUGHPUT, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          rx_bytes * 8 * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_CPU, "iut_rpc_server",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          cpu_time * 100.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    ibvts_hist_log(&compl_lat, logger, TE_MI_MEAS_LATENCY, "compl",
+                   TE_MI_MEAS_MULTIPLIER_MICRO, TRUE);
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    TEST_STEP("Free all allocated resources.");
+    rpc_ibv_detach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    rpc_ibv_dereg_mr(pco_iut, iut_mr);
+    ibvts_qp_fixture_destroy(&iut_fx);
+
+    rpc_ibv_dereg_mr(pco_tst, tst_mr);
+    ibvts_qp_fixture_destroy(&tst_fx);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    free(tx_buf);
+    free(iut_wr);
+    free(tst_wr);
+    free(wc);
+    rpc_free(pco_iut, iut_buffer);
+    rpc_free(pco_tst, tst_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
@@ -0,0 +1,320 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-inline_sweep Packet rate and latency with and without inline data
+ *
+ * @objective Measure packet rate and send completion latency of
+ *            @c IBV_QPT_RAW_PACKET QP depending on frame length and on
+ *            whether the frame is passed with @c IBV_SEND_INLINE or
+ *            fetched by DMA.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param send_inline        If it is @c TRUE, create @p tst_qp with
+ *                           @a max_inline_data equal to frame length and
+ *                           set @c IBV_SEND_INLINE in send WRs
+ * @param burst              Number of WRs posted by one call of
+ *                           @b ibv_post_send()/ @b ibv_post_recv()
+ * @param duration           Duration of traffic in seconds
+ * @param iter_num           Number of single frames sent to measure
+ *                           latency
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note Maximum size of inline data supported by Tester device is found
+ *       by probing @b ibv_create_qp() and is reported as a measurement
+ *       key. Iterations with @p send_inline and @p frame_len exceeding
+ *       it are skipped. Latency is measured from return of
+ *       @b ibv_post_send() till return of @b ibv_poll_cq() reporting the
+ *       send completion minus estimated RPC overhead.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/inline_sweep"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+#include "te_mi_log.h"
+
+#define BUF_SIZE 2048
+/** Timeout of waiting for completions of one burst, in milliseconds */
+#define BURST_TIMEOUT 1000
+/** Upper bound of inline data size probing */
+#define INLINE_PROBE_LIMIT 4096
+/** Number of calls used to estimate RPC overhead */
+#define OVERHEAD_CALLS 100
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        iut_fx;
+    ibvts_qp_fixture        tst_fx;
+    struct rpc_ibv_mr      *iut_mr = NULL;
+    struct rpc_ibv_mr      *tst_mr = NULL;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+
+    rpc_ptr                 iut_buffer = RPC_NULL;
+    rpc_ptr                 tst_buffer = RPC_NULL;
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    union rpc_ibv_gid       mgid;
+
+    struct rpc_ibv_sge      recv_sge;
+    struct rpc_ibv_sge      send_sge;
+    struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr *tst_bad_wr = NULL;
+    ibvts_traffic           traffic = { 0 };
+
+    int                     frame_len;
+    te_bool                 send_inline;
+    int                     burst;
+    int                     duration;
+    int                     iter_num;
+    ibvts_buf_backing       buf_backing;
+    int                     max_inline;
+
+    uint64_t                overhead;
+    uint64_t                lat;
+    ibvts_hist              lat_hist;
+
+    int                     got;
+    int                     i;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_BOOL_PARAM(send_inline);
+    TEST_GET_INT_PARAM(burst);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_INT_PARAM(iter_num);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&iut_fx, 0, sizeof(iut_fx));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&recv_sge, 0, sizeof(recv_sge));
+    memset(&send_sge, 0, sizeof(send_sge));
+    ibvts_hist_init(&lat_hist);
+
+    TEST_STEP("Find maximum size of inline data supported by @p pco_tst "
+              "device by probing @b ibv_create_qp(). Skip the iteration "
+              "if @p send_inline is @c TRUE and @p frame_len exceeds it.");
+    max_inline = ibvts_probe_max_inline(pco_tst, INLINE_PROBE_LIMIT);
+    RING("Maximum size of inline data on Tester is %d", max_inline);
+    if (send_inline && frame_len > max_inline)
+        TEST_SKIP("Frame length exceeds maximum size of inline data");
+
+    TEST_STEP("Create buffers @p iut_buffer and @p tst_buffer on @p pco_iut "
+              "and @p pco_tst.");
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+
+    iut_buffer = rpc_memalign(pco_iut, TEST_PAGE_SIZE, BUF_SIZE);
+    tst_buffer = rpc_memalign(pco_tst, TEST_PAGE_SIZE, BUF_SIZE);
+
+    TEST_STEP("Create device context, protection domain, send and receive "
+              "completion queues and @c IBV_QPT_RAW_PACKET QP @p iut_qp "
+              "on @p pco_iut, move the QP to @c IBV_QPS_RTS state.");
+    fx_desc.max_send_sge = 1;
+    fx_desc.max_recv_sge = 1;
+    CHECK_RC(ibvts_qp_fixture_create(pco_iut, &fx_desc, &iut_fx));
+    if (burst > iut_fx.pool_size)
+        TEST_FAIL("'burst' parameter exceeds the queue size %d supported "
+                  "by IUT device", iut_fx.pool_size);
+
+    TEST_STEP("Create memory region for @p iut_buffer on @p pco_iut.");
+    iut_mr = rpc_ibv_reg_mr(pco_iut, iut_fx.pd, iut_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+
+    TEST_STEP("Create the same set of resources with @p sq_sig_all set "
+              "to @c 1 and @a max_inline_data set to @p frame_len if "
+              "@p send_inline is @c TRUE for @p tst_qp and memory region "
+              "for @p tst_buffer on @p pco_tst.");
+    fx_desc.sq_sig_all = TRUE;
+    fx_desc.max_inline_data = send_inline ? frame_len : 0;
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+    if (burst > tst_fx.pool_size)
+        TEST_FAIL("'burst' parameter exceeds the queue size %d supported "
+                  "by Tester device", tst_fx.pool_size);
+    tst_mr = rpc_ibv_reg_mr(pco_tst, tst_fx.pd, tst_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+
+    TEST_STEP("Attach @p iut_qp to multicast group according to "
+              "@p mcast_addr.");
+    ibvts_fill_gid(mcast_addr, &mgid);
+    rpc_ibv_attach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_STEP("Create raw multicast packet of @p frame_len length and write "
+              "it to @p tst_buffer.");
+    pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                       mcast_addr, 0, TRUE, tx_buf,
+                                       frame_len - sizeof(te_eth_ip_udp_hdr),
+                                       packet);
+    rpc_set_buf_gen(pco_tst, packet, (size_t)pkt_len, tst_buffer, 0);
+
+    TEST_STEP("Prepare lists of @p burst send WRs on @p pco_tst and receive "
+              "WRs on @p pco_iut. All send WRs refer to the same packet in "
+              "@p tst_buffer and have @c IBV_SEND_INLINE set if "
+              "@p send_inline is @c TRUE, all receive WRs refer to "
+              "@p iut_buffer.");
+    recv_sge.addr = iut_buffer;
+    recv_sge.length = BUF_SIZE;
+    recv_sge.lkey = iut_mr->lkey;
+
+    send_sge.addr = tst_buffer;
+    send_sge.length = pkt_len;
+    send_sge.lkey = tst_mr->lkey;
+
+    ibvts_traffic_init(&traffic, &tst_fx, &send_sge, 1,
+                       IBV_SEND_IP_CSUM |
+                            (send_inline ? IBV_SEND_INLINE : 0),
+                       &iut_fx, &recv_sge, 1, burst, 0);
+
+    TEST_STEP("During @p duration seconds repeat: refill receive queue "
+              "of @p iut_qp up to @p burst WRs, post @p burst send WRs on "
+              "@p tst_qp, wait for their completions on @p tst_scq and "
+              "for receive completions on @p iut_rcq.");
+    rc = ibvts_traffic_run(&traffic, duration, BURST_TIMEOUT);
+    if (rc != 0)
+        TEST_VERDICT("Burst of WRs was not completed successfully: %r", rc);
+
+    TEST_STEP("Estimate RPC overhead of @b ibv_poll_cq() call on "
+              "@p pco_tst calling it on empty @p tst_scq.");
+    overhead = ibvts_rpc_overhead(pco_tst, tst_fx.scq, OVERHEAD_CALLS);
+
+    TEST_STEP("Repeat @p iter_num times: post one send WR on @p tst_qp, "
+              "wait for its completion and add time passed since posting "
+              "minus RPC overhead to latency histogram; wait for receive "
+              "completion on @p iut_rcq.");
+    ibvts_rpcs_set_silent(pco_iut, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    for (i = 0; i < iter_num; i++)
+    {
+        if (traffic.rx_posted < 1)
+        {
+            rpc_ibv_post_recv(pco_iut, iut_fx.qp->qp,
+                              &traffic.recv_wr[burst - 1], &iut_bad_wr);
+            traffic.rx_posted++;
+        }
+
+        rpc_ibv_post_send(pco_tst, tst_fx.qp->qp,
+                          &traffic.send_wr[burst - 1], &tst_bad_wr);
+        got = ibvts_poll_cq_wait(pco_tst, tst_fx.scq, 1, BURST_TIMEOUT, FALSE,
+                                 traffic.wc, &lat);
+        if (got != 1 || !ibvts_check_wc(traffic.wc, got, NULL))
+            TEST_VERDICT("Send WR was not completed successfully");
+        ibvts_hist_add(&lat_hist, lat > overhead ? lat - overhead : 0);
+
+        got = ibvts_poll_cq_wait(pco_iut, iut_fx.rcq, 1, BURST_TIMEOUT, FALSE,
+                                 traffic.wc, NULL);
+        if (!ibvts_check_wc(traffic.wc, got, NULL))
+            TEST_VERDICT("Receive WR completed with error");
+        traffic.rx_posted -= got;
+    }
+    ibvts_rpcs_set_silent(pco_iut, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+
+    TEST_STEP("Report maximum size of inline data, packet and bit rates "
+              "of sent and received traffic, rate of posting send WRs on "
+              "@p pco_tst and send completion latency histogram.");
+    RING("Sent %" PRIu64 " packets (%" PRIu64 " bytes), received %"
+         PRIu64 " packets (%" PRIu64 " bytes) in %" PRIu64 " us, "
+         "ibv_post_send() took %" PRIu64 " us in total",
+         traffic.tx_pkts, traffic.tx_bytes, traffic.rx_pkts,
+         traffic.rx_bytes, traffic.elapsed, traffic.post_send_time);
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_meas_key(logger, NULL, "frame_len", "%d", frame_len);
+    te_mi_logger_add_meas_key(logger, NULL, "send_inline", "%s",
+                              send_inline ? "TRUE" : "FALSE");
+    te_mi_logger_add_meas_key(logger, NULL, "burst", "%d", burst);
+    te_mi_logger_add_meas_key(logger, NULL, "max_inline", "%d", max_inline);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "tx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          traffic.tx_pkts * 1000000.0 / traffic.elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          traffic.rx_pkts * 1000000.0 / traffic.elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_THROUGHPUT, "tx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          traffic.tx_bytes * 8 * 1000000.0 /
+                              traffic.elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_THROUGHPUT, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          traffic.rx_bytes * 8 * 1000000.0 /
+                              traffic.elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    if (traffic.post_send_time > 0)
+    {
+        te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "post_send",
+                              TE_MI_MEAS_AGGR_MEAN,
+                              traffic.tx_pkts * 1000000.0 /
+                                  traffic.post_send_time,
+                              TE_MI_MEAS_MULTIPLIER_PLAIN);
+    }
+    ibvts_hist_log(&lat_hist, logger, TE_MI_MEAS_LATENCY, "tx_compl",
+                   TE_MI_MEAS_MULTIPLIER_MICRO, TRUE);
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    if (traffic.rx_pkts == 0)
+        TEST_VERDICT("No packets were received");
+    if (traffic.rx_pkts < traffic.tx_pkts)
+        RING_VERDICT("Some packets were lost");
+
+    TEST_STEP("Free all allocated resources.");
+    rpc_ibv_detach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    rpc_ibv_dereg_mr(pco_iut, iut_mr);
+    ibvts_qp_fixture_destroy(&iut_fx);
+
+    rpc_ibv_dereg_mr(pco_tst, tst_mr);
+    ibvts_qp_fixture_destroy(&tst_fx);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    free(tx_buf);
+    ibvts_traffic_free(&traffic);
+    rpc_free(pco_iut, iut_buffer);
+    rpc_free(pco_tst, tst_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
@@ -0,0 +1,451 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-mcast_steering Scaling of multicast attachments of IBV_QPT_RAW_PACKET QPs
+ *
+ * @objective Measure cost of attaching multicast groups to QPs by
+ *            @b ibv_attach_mcast() and check correctness of steering and
+ *            receive packet rate depending on number of attached groups.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address, address of each next
+ *                           multicast group is incremented by 1
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param qp_num             Number of QPs on IUT
+ * @param rule_num           Number of multicast groups attached to QPs
+ *                           on IUT, group @c i is attached to QP
+ *                           @c i % @p qp_num
+ * @param burst              Number of packets sent in a round
+ * @param duration           Duration of traffic in seconds
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note The test measures @b ibv_attach_mcast(), not scaling of flow
+ *       steering rules created by @b ibv_create_flow(): flow steering
+ *       API is not available via RPC. A "rule" here is one multicast
+ *       group attached to one QP, which makes the device steer packets
+ *       by destination MAC and GID. The test is skipped if @p rule_num
+ *       exceeds multicast limits reported by @b ibv_query_device().
+ *       Packets are sent to up to @c PROBE_NUM groups spread evenly over
+ *       all attached ones and to one group which is not attached.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/mcast_steering"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+
+#define BUF_SIZE 2048
+/** Timeout of waiting for completions of one round, in milliseconds */
+#define ROUND_TIMEOUT 1000
+/** Maximum number of send WRs posted by one call */
+#define TX_CHUNK 256
+/** Maximum number of attached groups traffic is sent to */
+#define PROBE_NUM 64
+
+/**
+ * Fill address of multicast group.
+ *
+ * @param base      Address of the first group
+ * @param idx       Index of the group
+ * @param addr      Address to be filled (OUT)
+ */
+static void
+get_grp_addr(const struct sockaddr *base, int idx, struct sockaddr_in *addr)
+{
+    memcpy(addr, base, sizeof(*addr));
+    addr->sin_addr.s_addr = htonl(ntohl(SIN(base)->sin_addr.s_addr) + idx);
+}
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+
+    struct rpc_ibv_context     *iut_context = NULL;
+    int                         iut_ibv_port = 0;
+    struct rpc_ibv_device_attr  attr;
+    rpc_ptr                     iut_pd = RPC_NULL;
+    struct rpc_ibv_mr          *iut_mr = NULL;
+    rpc_ptr                     iut_scq = RPC_NULL;
+    rpc_ptr                    *iut_rcq = NULL;
+    struct rpc_ibv_qp         **iut_qp = NULL;
+    union rpc_ibv_gid          *mgid = NULL;
+    struct rpc_ibv_qp_init_attr qp_attr;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        tst_fx;
+    ibvts_buf_pool          tst_pool;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+    struct sockaddr_in      grp_addr;
+
+    rpc_ptr                 iut_buffer = RPC_NULL;
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    struct rpc_ibv_sge      recv_sge;
+    struct rpc_ibv_sge     *send_sge = NULL;
+    struct rpc_ibv_recv_wr *iut_wr = NULL;
+    struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr *tst_wr = NULL;
+    struct rpc_ibv_send_wr *tst_bad_wr = NULL;
+    struct rpc_ibv_wc      *wc = NULL;
+
+    int                     frame_len;
+    int                     qp_num;
+    int                     rule_num;
+    int                     burst;
+    int                     duration;
+    ibvts_buf_backing       buf_backing;
+
+    struct timeval          tv_start;
+    struct timeval          tv_now;
+    uint64_t                attach_time = 0;
+    uint64_t                detach_time = 0;
+    uint64_t                elapsed = 0;
+
+    int                     probe_num;
+    int                    *probe_grp = NULL;
+    int                    *exp = NULL;
+    uint64_t               *qp_pkts = NULL;
+    int                    *rx_posted = NULL;
+    uint64_t                tx_pkts = 0;
+    uint64_t                rx_pkts = 0;
+    uint64_t                rounds = 0;
+    int                     chunk;
+    int                     got;
+    int                     i;
+    int                     k;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_INT_PARAM(qp_num);
+    TEST_GET_INT_PARAM(rule_num);
+    TEST_GET_INT_PARAM(burst);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+    if (qp_num < 1 || rule_num < qp_num)
+        TEST_FAIL("'rule_num' parameter must not be less than 'qp_num'");
+
+    probe_num = MIN(rule_num, PROBE_NUM);
+    if (burst <= probe_num)
+        TEST_FAIL("'burst' parameter must be greater than %d", probe_num);
+
+    memset(&attr, 0, sizeof(attr));
+    memset(&qp_attr, 0, sizeof(qp_attr));
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&tst_pool, 0, sizeof(tst_pool));
+    memset(&recv_sge, 0, sizeof(recv_sge));
+
+    iut_rcq = tapi_calloc(qp_num, sizeof(*iut_rcq));
+    iut_qp = tapi_calloc(qp_num, sizeof(*iut_qp));
+    mgid = tapi_calloc(rule_num, sizeof(*mgid));
+    probe_grp = tapi_calloc(probe_num + 1, sizeof(*probe_grp));
+    exp = tapi_calloc(qp_num, sizeof(*exp));
+    qp_pkts = tapi_calloc(qp_num, sizeof(*qp_pkts));
+    rx_posted = tapi_calloc(qp_num, sizeof(*rx_posted));
+    send_sge = tapi_calloc(probe_num + 1, sizeof(*send_sge));
+    iut_wr = tapi_calloc(burst, sizeof(*iut_wr));
+    tst_wr = tapi_calloc(burst, sizeof(*tst_wr));
+    wc = tapi_calloc(burst, sizeof(*wc));
+
+    TEST_STEP("Create device context, protection domain, send CQ and "
+              "memory region for receive buffer on @p pco_iut. Skip the "
+              "test if @p rule_num exceeds maximum number of multicast "
+              "groups or of multicast attachments of the device.");
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+    iut_buffer = rpc_memalign(pco_iut, TEST_PAGE_SIZE, BUF_SIZE);
+
+    iut_context = rpc_ibv_open_device(pco_iut, &iut_ibv_port);
+    iut_pd = rpc_ibv_alloc_pd(pco_iut, iut_context->context);
+    rpc_ibv_query_device(pco_iut, iut_context->context, &attr);
+    if (qp_num > attr.max_qp)
+        TEST_FAIL("'qp_num' parameter exceeds number of QPs %d supported "
+                  "by IUT device", attr.max_qp);
+    if (burst > attr.max_cqe || burst > attr.max_qp_wr)
+        TEST_FAIL("'burst' parameter exceeds the queue size supported "
+                  "by IUT device");
+    RING("IUT device supports %d multicast groups, %d QPs per group and "
+         "%d attachments in total", attr.max_mcast_grp,
+         attr.max_mcast_qp_attach, attr.max_total_mcast_qp_attach);
+    if (rule_num > attr.max_mcast_grp || attr.max_mcast_qp_attach < 1 ||
+        rule_num > attr.max_total_mcast_qp_attach)
+        TEST_SKIP("IUT device does not support %d multicast attachments",
+                  rule_num);
+
+    iut_mr = rpc_ibv_reg_mr(pco_iut, iut_pd, iut_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+    iut_scq = rpc_ibv_create_cq(pco_iut, iut_context->context, 1,
+                                RPC_NULL, RPC_NULL, 0);
+
+    TEST_STEP("Create @p qp_num @c IBV_QPT_RAW_PACKET QPs with their own "
+              "receive CQs on @p pco_iut and move them to "
+              "@c IBV_QPS_RTS state.");
+    for (k = 0; k < qp_num; k++)
+    {
+        iut_rcq[k] = rpc_ibv_create_cq(pco_iut, iut_context->context,
+                                       burst, RPC_NULL, RPC_NULL, 0);
+
+        qp_attr.send_cq = iut_scq;
+        qp_attr.recv_cq = iut_rcq[k];
+        qp_attr.cap.max_send_wr = 1;
+        qp_attr.cap.max_recv_wr = burst;
+        qp_attr.cap.max_send_sge = 1;
+        qp_attr.cap.max_recv_sge = 1;
+        qp_attr.qp_type = IBV_QPT_RAW_PACKET;
+        iut_qp[k] = rpc_ibv_create_qp(pco_iut, iut_pd, &qp_attr);
+        ibvts_qp_to_rts(pco_iut, iut_qp[k], iut_ibv_port);
+    }
+
+    TEST_STEP("Attach @p rule_num multicast groups to QPs on @p pco_iut "
+              "in round-robin order. Sum up time spent inside "
+              "@b ibv_attach_mcast() calls.");
+    for (i = 0; i < rule_num; i++)
+    {
+        get_grp_addr(mcast_addr, i, &grp_addr);
+        ibvts_fill_gid(SA(&grp_addr), &mgid[i]);
+        rpc_ibv_attach_mcast(pco_iut, iut_qp[i % qp_num]->qp, &mgid[i], 0);
+        attach_time += pco_iut->duration;
+    }
+
+    TEST_STEP("Create @c IBV_QPT_RAW_PACKET QP @p tst_qp with @p sq_sig_all "
+              "set to @c 1 on @p pco_tst.");
+    fx_desc.max_send_wr = MIN(burst, TX_CHUNK);
+    fx_desc.max_recv_wr = 1;
+    fx_desc.max_send_sge = 1;
+    fx_desc.max_recv_sge = 1;
+    fx_desc.sq_sig_all = TRUE;
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+
+    TEST_STEP("Choose up to @c PROBE_NUM attached groups spread evenly "
+              "over all of them and one group which is not attached. "
+              "Create a buffer on @p pco_tst for each chosen group and "
+              "write to it raw packet of @p frame_len length addressed "
+              "to the group.");
+    for (i = 0; i < probe_num; i++)
+        probe_grp[i] = (int)((int64_t)i * rule_num / probe_num);
+    probe_grp[probe_num] = rule_num;
+
+    ibvts_buf_pool_create(pco_tst, tst_fx.pd, probe_num + 1, TEST_PAGE_SIZE,
+                          BUF_SIZE, IBV_ACCESS_LOCAL_WRITE, &tst_pool);
+    for (i = 0; i <= probe_num; i++)
+    {
+        get_grp_addr(mcast_addr, probe_grp[i], &grp_addr);
+        pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                           SA(&grp_addr), 0, TRUE, tx_buf,
+                                           frame_len -
+                                           sizeof(te_eth_ip_udp_hdr),
+                                           packet);
+        ibvts_buf_pool_write(&tst_pool, i, packet, (size_t)pkt_len);
+        ibvts_buf_pool_sge(&tst_pool, i, pkt_len, &send_sge[i]);
+    }
+
+    TEST_STEP("Prepare list of @p burst send WRs on @p pco_tst addressing "
+              "attached groups chosen above in round-robin order, the last "
+              "WR addresses not attached group. Calculate number of "
+              "packets each QP on IUT should get in a round. Prepare list "
+              "of @p burst receive WRs on @p pco_iut.");
+    recv_sge.addr = iut_buffer;
+    recv_sge.length = BUF_SIZE;
+    recv_sge.lkey = iut_mr->lkey;
+    for (i = 0; i < burst; i++)
+    {
+        iut_wr[i].next = (i == burst - 1) ? NULL : &iut_wr[i + 1];
+        iut_wr[i].sg_list = &recv_sge;
+        iut_wr[i].num_sge = 1;
+    }
+    for (i = 0; i < burst; i++)
+    {
+        k = (i == burst - 1) ? probe_num : i % probe_num;
+        if (k < probe_num)
+            exp[probe_grp[k] % qp_num]++;
+
+        tst_wr[i].next = ((i + 1) % TX_CHUNK == 0 || i == burst - 1) ?
+                         NULL : &tst_wr[i + 1];
+        tst_wr[i].sg_list = &send_sge[k];
+        tst_wr[i].num_sge = 1;
+        tst_wr[i].opcode = IBV_WR_SEND;
+        tst_wr[i].send_flags = IBV_SEND_IP_CSUM;
+        tst_wr[i].wr_id = i;
+    }
+
+    TEST_STEP("During @p duration seconds repeat:");
+    ibvts_rpcs_set_silent(pco_iut, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    gettimeofday(&tv_start, NULL);
+    do {
+        TEST_SUBSTEP("Refill receive queue of each QP on IUT up to "
+                     "@p burst WRs.");
+        for (k = 0; k < qp_num; k++)
+        {
+            if (rx_posted[k] == burst)
+                continue;
+            rpc_ibv_post_recv(pco_iut, iut_qp[k]->qp, &iut_wr[rx_posted[k]],
+                              &iut_bad_wr);
+            rx_posted[k] = burst;
+        }
+
+        TEST_SUBSTEP("Post @p burst send WRs on @p tst_qp by chunks and "
+                     "wait for their completions.");
+        for (i = 0; i < burst; i += chunk)
+        {
+            chunk = MIN(TX_CHUNK, burst - i);
+            rpc_ibv_post_send(pco_tst, tst_fx.qp->qp, &tst_wr[i],
+                              &tst_bad_wr);
+            got = ibvts_poll_cq_wait(pco_tst, tst_fx.scq, chunk,
+                                     ROUND_TIMEOUT, FALSE, wc, NULL);
+            if (got != chunk)
+                TEST_VERDICT("Not all send WRs were completed");
+            tx_pkts += got;
+        }
+        rounds++;
+
+        TEST_SUBSTEP("Get receive completions from receive CQ of each QP "
+                     "on IUT and count packets received by it.");
+        for (k = 0; k < qp_num; k++)
+        {
+            got = ibvts_poll_cq_wait(pco_iut, iut_rcq[k], exp[k],
+                                     ROUND_TIMEOUT, FALSE, wc, NULL);
+            if (!ibvts_check_wc(wc, got, NULL))
+            {
+                ERROR("Receive WR of QP %d completed with error", k);
+                TEST_VERDICT("Receive WR completed with error");
+            }
+            qp_pkts[k] += got;
+            rx_posted[k] -= got;
+            rx_pkts += got;
+        }
+
+        gettimeofday(&tv_now, NULL);
+        elapsed = TIMEVAL_SUB(tv_now, tv_start);
+    } while (elapsed < (uint64_t)TE_SEC2US(duration));
+    ibvts_rpcs_set_silent(pco_iut, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+
+    TEST_STEP("Check that no QP has got more packets than it was sent to "
+              "its groups.");
+    for (k = 0; k < qp_num; k++)
+    {
+        got = rpc_ibv_poll_cq(pco_iut, iut_rcq[k], burst, wc);
+        qp_pkts[k] += got;
+        rx_pkts += got;
+        if (qp_pkts[k] > rounds * exp[k])
+        {
+            ERROR("QP %d got %" PRIu64 " packets instead of %" PRIu64,
+                  k, qp_pkts[k], rounds * exp[k]);
+            TEST_VERDICT("Packets were delivered to a wrong QP or to "
+                         "a group which is not attached");
+        }
+    }
+
+    TEST_STEP("Detach all multicast groups summing up time spent inside "
+              "@b ibv_detach_mcast() calls.");
+    for (i = 0; i < rule_num; i++)
+    {
+        rpc_ibv_detach_mcast(pco_iut, iut_qp[i % qp_num]->qp, &mgid[i], 0);
+        detach_time += pco_iut->duration;
+    }
+
+    TEST_STEP("Report time spent per rule by @b ibv_attach_mcast() and "
+              "@b ibv_detach_mcast() and receive packet rate.");
+    RING("Attaching of %d groups took %" PRIu64 " us, detaching took %"
+         PRIu64 " us; sent %" PRIu64 " packets, received %" PRIu64
+         " packets of %" PRIu64 " expected in %" PRIu64 " us", rule_num,
+         attach_time, detach_time, tx_pkts, rx_pkts,
+         tx_pkts - rounds, elapsed);
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_meas_key(logger, NULL, "frame_len", "%d", frame_len);
+    te_mi_logger_add_meas_key(logger, NULL, "qp_num", "%d", qp_num);
+    te_mi_logger_add_meas_key(logger, NULL, "rule_num", "%d", rule_num);
+    te_mi_logger_add_meas_key(logger, NULL, "burst", "%d", burst);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "attach_per_rule", TE_MI_MEAS_AGGR_MEAN,
+                          (double)attach_time / rule_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "detach_per_rule", TE_MI_MEAS_AGGR_MEAN,
+                          (double)detach_time / rule_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "tx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          tx_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          rx_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    if (rx_pkts == 0)
+        TEST_VERDICT("No packets were received");
+    if (rx_pkts < tx_pkts - rounds)
+        RING_VERDICT("Some packets were lost");
+
+    TEST_STEP("Free all allocated resources.");
+    for (k = 0; k < qp_num; k++)
+    {
+        rpc_ibv_destroy_qp(pco_iut, iut_qp[k]);
+        rpc_ibv_destroy_cq(pco_iut, iut_rcq[k]);
+    }
+    rpc_ibv_destroy_cq(pco_iut, iut_scq);
+    rpc_ibv_dereg_mr(pco_iut, iut_mr);
+    rpc_ibv_dealloc_pd(pco_iut, iut_pd);
+    rpc_ibv_close_device(pco_iut, iut_context);
+
+    ibvts_buf_pool_destroy(&tst_pool);
+    ibvts_qp_fixture_destroy(&tst_fx);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    free(tx_buf);
+    free(iut_rcq);
+    free(iut_qp);
+    free(mgid);
+    free(probe_grp);
+    free(exp);
+    free(qp_pkts);
+    free(rx_posted);
+    free(send_sge);
+    free(iut_wr);
+    free(tst_wr);
+    free(wc);
+    rpc_free(pco_iut, iut_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
@@ -0,0 +1,422 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-multi_qp Packet rate and fairness of many IBV_QPT_RAW_PACKET QPs
+ *
+ * @objective Measure how aggregate packet rate and fairness between QPs
+ *            scale with number of @c IBV_QPT_RAW_PACKET QPs receiving
+ *            traffic and with sharing of receive CQ between them.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address, address of multicast
+ *                           group of each next QP is incremented by 1
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param qp_num             Number of QPs on IUT
+ * @param shared_cq          If @c TRUE, all QPs on IUT use the same
+ *                           receive CQ, otherwise each QP has its own
+ *                           receive CQ
+ * @param burst              Number of packets sent to each QP in a round
+ * @param duration           Duration of traffic in seconds
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note Each QP has its own receive queue. There is no shared receive
+ *       queue (SRQ) variant and no SRQ footprint comparison: verbs RPCs
+ *       the suite is built on do not provide @b ibv_create_srq(),
+ *       @b ibv_post_srq_recv() and SRQ limit events.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/multi_qp"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+
+#define BUF_SIZE 2048
+/**
+ * Timeout of waiting for completions of one round, in milliseconds; on IUT
+ * it is common for all receive CQs
+ */
+#define ROUND_TIMEOUT 1000
+/** Maximum number of send WRs posted by one call */
+#define TX_CHUNK 256
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+
+    struct rpc_ibv_context     *iut_context = NULL;
+    int                         iut_ibv_port = 0;
+    struct rpc_ibv_device_attr  attr;
+    rpc_ptr                     iut_pd = RPC_NULL;
+    struct rpc_ibv_mr          *iut_mr = NULL;
+    rpc_ptr                     iut_scq = RPC_NULL;
+    rpc_ptr                    *iut_rcq = NULL;
+    struct rpc_ibv_qp         **iut_qp = NULL;
+    union rpc_ibv_gid          *mgid = NULL;
+    struct rpc_ibv_qp_init_attr qp_attr;
+    int                         rcq_num;
+    int                         rcq_size;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        tst_fx;
+    ibvts_buf_pool          tst_pool;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+    struct sockaddr_in      grp_addr;
+
+    rpc_ptr                 iut_buffer = RPC_NULL;
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    struct rpc_ibv_sge      recv_sge;
+    struct rpc_ibv_sge     *send_sge = NULL;
+    struct rpc_ibv_recv_wr *iut_wr = NULL;
+    struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr *tst_wr = NULL;
+    struct rpc_ibv_send_wr *tst_bad_wr = NULL;
+    struct rpc_ibv_wc      *wc = NULL;
+
+    int                     frame_len;
+    int                     qp_num;
+    te_bool                 shared_cq;
+    int                     burst;
+    int                     duration;
+    ibvts_buf_backing       buf_backing;
+
+    struct timeval          tv_start;
+    struct timeval          tv_now;
+    struct timeval          tv_round;
+    uint64_t                setup_time;
+    uint64_t                elapsed = 0;
+
+    uint64_t               *qp_pkts = NULL;
+    int                    *rx_posted = NULL;
+    int                    *rcq_got = NULL;
+    int                     rcq_pending;
+    uint64_t                tx_pkts = 0;
+    uint64_t                rx_pkts = 0;
+    uint64_t                min_pkts;
+    uint64_t                max_pkts;
+    int                     tx_num;
+    int                     chunk;
+    int                     exp;
+    int                     got;
+    int                     i;
+    int                     k;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_INT_PARAM(qp_num);
+    TEST_GET_BOOL_PARAM(shared_cq);
+    TEST_GET_INT_PARAM(burst);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+
+    tx_num = qp_num * burst;
+    rcq_num = shared_cq ? 1 : qp_num;
+    rcq_size = shared_cq ? tx_num : burst;
+    exp = rcq_size;
+
+    memset(&attr, 0, sizeof(attr));
+    memset(&qp_attr, 0, sizeof(qp_attr));
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&tst_pool, 0, sizeof(tst_pool));
+    memset(&recv_sge, 0, sizeof(recv_sge));
+
+    iut_rcq = tapi_calloc(qp_num, sizeof(*iut_rcq));
+    iut_qp = tapi_calloc(qp_num, sizeof(*iut_qp));
+    mgid = tapi_calloc(qp_num, sizeof(*mgid));
+    qp_pkts = tapi_calloc(qp_num, sizeof(*qp_pkts));
+    rx_posted = tapi_calloc(qp_num, sizeof(*rx_posted));
+    rcq_got = tapi_calloc(rcq_num, sizeof(*rcq_got));
+    send_sge = tapi_calloc(qp_num, sizeof(*send_sge));
+    iut_wr = tapi_calloc(burst, sizeof(*iut_wr));
+    tst_wr = tapi_calloc(tx_num, sizeof(*tst_wr));
+    wc = tapi_calloc(tx_num, sizeof(*wc));
+
+    TEST_STEP("Create device context, protection domain, send CQ and "
+              "memory region for receive buffer on @p pco_iut.");
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+    iut_buffer = rpc_memalign(pco_iut, TEST_PAGE_SIZE, BUF_SIZE);
+
+    iut_context = rpc_ibv_open_device(pco_iut, &iut_ibv_port);
+    iut_pd = rpc_ibv_alloc_pd(pco_iut, iut_context->context);
+    rpc_ibv_query_device(pco_iut, iut_context->context, &attr);
+    if (qp_num > attr.max_qp)
+        TEST_FAIL("'qp_num' parameter exceeds number of QPs %d supported "
+                  "by IUT device", attr.max_qp);
+    if (rcq_size > attr.max_cqe || burst > attr.max_qp_wr)
+        TEST_FAIL("Queue size required by 'qp_num' and 'burst' parameters "
+                  "is not supported by IUT device");
+
+    iut_mr = rpc_ibv_reg_mr(pco_iut, iut_pd, iut_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+    iut_scq = rpc_ibv_create_cq(pco_iut, iut_context->context, 1,
+                                RPC_NULL, RPC_NULL, 0);
+
+    TEST_STEP("Create @p qp_num @c IBV_QPT_RAW_PACKET QPs on @p pco_iut "
+              "with one shared receive CQ or with receive CQ per QP "
+              "according to @p shared_cq. Move each QP to @c IBV_QPS_RTS "
+              "state and attach it to its own multicast group. Measure "
+              "time spent per QP.");
+    memcpy(&grp_addr, mcast_addr, sizeof(grp_addr));
+    gettimeofday(&tv_start, NULL);
+    for (k = 0; k < qp_num; k++)
+    {
+        if (k < rcq_num)
+            iut_rcq[k] = rpc_ibv_create_cq(pco_iut, iut_context->context,
+                                           rcq_size, RPC_NULL, RPC_NULL, 0);
+
+        qp_attr.send_cq = iut_scq;
+        qp_attr.recv_cq = iut_rcq[shared_cq ? 0 : k];
+        qp_attr.cap.max_send_wr = 1;
+        qp_attr.cap.max_recv_wr = burst;
+        qp_attr.cap.max_send_sge = 1;
+        qp_attr.cap.max_recv_sge = 1;
+        qp_attr.qp_type = IBV_QPT_RAW_PACKET;
+        iut_qp[k] = rpc_ibv_create_qp(pco_iut, iut_pd, &qp_attr);
+        ibvts_qp_to_rts(pco_iut, iut_qp[k], iut_ibv_port);
+
+        grp_addr.sin_addr.s_addr =
+            htonl(ntohl(SIN(mcast_addr)->sin_addr.s_addr) + k);
+        ibvts_fill_gid(SA(&grp_addr), &mgid[k]);
+        rpc_ibv_attach_mcast(pco_iut, iut_qp[k]->qp, &mgid[k], 0);
+    }
+    gettimeofday(&tv_now, NULL);
+    setup_time = TIMEVAL_SUB(tv_now, tv_start);
+
+    TEST_STEP("Create @c IBV_QPT_RAW_PACKET QP @p tst_qp with @p sq_sig_all "
+              "set to @c 1 on @p pco_tst.");
+    fx_desc.max_send_wr = MIN(tx_num, TX_CHUNK);
+    fx_desc.max_recv_wr = 1;
+    fx_desc.max_send_sge = 1;
+    fx_desc.max_recv_sge = 1;
+    fx_desc.sq_sig_all = TRUE;
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+
+    TEST_STEP("Create @p qp_num buffers on @p pco_tst and write to each of "
+              "them raw packet of @p frame_len length addressed to "
+              "multicast group of the corresponding QP on IUT.");
+    ibvts_buf_pool_create(pco_tst, tst_fx.pd, qp_num, TEST_PAGE_SIZE,
+                          BUF_SIZE, IBV_ACCESS_LOCAL_WRITE, &tst_pool);
+    for (k = 0; k < qp_num; k++)
+    {
+        grp_addr.sin_addr.s_addr =
+            htonl(ntohl(SIN(mcast_addr)->sin_addr.s_addr) + k);
+        pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                           SA(&grp_addr), 0, TRUE, tx_buf,
+                                           frame_len -
+                                           sizeof(te_eth_ip_udp_hdr),
+                                           packet);
+        ibvts_buf_pool_write(&tst_pool, k, packet, (size_t)pkt_len);
+        ibvts_buf_pool_sge(&tst_pool, k, pkt_len, &send_sge[k]);
+    }
+
+    TEST_STEP("Prepare list of @p burst * @p qp_num send WRs on @p pco_tst "
+              "addressing QPs on IUT in round-robin order and list of "
+              "@p burst receive WRs on @p pco_iut.");
+    recv_sge.addr = iut_buffer;
+    recv_sge.length = BUF_SIZE;
+    recv_sge.lkey = iut_mr->lkey;
+    for (i = 0; i < burst; i++)
+    {
+        iut_wr[i].next = (i == burst - 1) ? NULL : &iut_wr[i + 1];
+        iut_wr[i].sg_list = &recv_sge;
+        iut_wr[i].num_sge = 1;
+    }
+    for (i = 0; i < tx_num; i++)
+    {
+        tst_wr[i].next = ((i + 1) % TX_CHUNK == 0 || i == tx_num - 1) ?
+                         NULL : &tst_wr[i + 1];
+        tst_wr[i].sg_list = &send_sge[i % qp_num];
+        tst_wr[i].num_sge = 1;
+        tst_wr[i].opcode = IBV_WR_SEND;
+        tst_wr[i].send_flags = IBV_SEND_IP_CSUM;
+        tst_wr[i].wr_id = i;
+    }
+
+    TEST_STEP("During @p duration seconds repeat:");
+    ibvts_rpcs_set_silent(pco_iut, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    gettimeofday(&tv_start, NULL);
+    do {
+        TEST_SUBSTEP("Refill receive queue of each QP on IUT up to "
+                     "@p burst WRs. Receive WRs carry QP index as "
+                     "@p wr_id.");
+        for (k = 0; k < qp_num; k++)
+        {
+            if (rx_posted[k] == burst)
+                continue;
+            for (i = rx_posted[k]; i < burst; i++)
+                iut_wr[i].wr_id = k;
+            rpc_ibv_post_recv(pco_iut, iut_qp[k]->qp, &iut_wr[rx_posted[k]],
+                              &iut_bad_wr);
+            rx_posted[k] = burst;
+        }
+
+        TEST_SUBSTEP("Post @p burst * @p qp_num send WRs on @p tst_qp by "
+                     "chunks and wait for their completions.");
+        for (i = 0; i < tx_num; i += chunk)
+        {
+            chunk = MIN(TX_CHUNK, tx_num - i);
+            rpc_ibv_post_send(pco_tst, tst_fx.qp->qp, &tst_wr[i],
+                              &tst_bad_wr);
+            got = ibvts_poll_cq_wait(pco_tst, tst_fx.scq, chunk,
+                                     ROUND_TIMEOUT, FALSE, wc, NULL);
+            if (got != chunk)
+                TEST_VERDICT("Not all send WRs were completed");
+            tx_pkts += got;
+        }
+
+        TEST_SUBSTEP("Poll receive CQ(s) on IUT in turn until each of "
+                     "them reports all expected completions or round "
+                     "timeout common for all of them expires, and count "
+                     "packets received by each QP.");
+        memset(rcq_got, 0, rcq_num * sizeof(*rcq_got));
+        rcq_pending = rcq_num;
+        gettimeofday(&tv_round, NULL);
+        do {
+            for (k = 0; k < rcq_num; k++)
+            {
+                if (rcq_got[k] == exp)
+                    continue;
+
+                got = rpc_ibv_poll_cq(pco_iut, iut_rcq[k],
+                                      exp - rcq_got[k], wc);
+                for (i = 0; i < got; i++)
+                {
+                    if (wc[i].status != IBV_WC_SUCCESS)
+                    {
+                        ERROR("Receive WR of QP %llu completed with "
+                              "status %d",
+                              (unsigned long long)wc[i].wr_id,
+                              wc[i].status);
+                        TEST_VERDICT("Receive WR completed with error");
+                    }
+                    qp_pkts[wc[i].wr_id]++;
+                    rx_posted[wc[i].wr_id]--;
+                }
+                rx_pkts += got;
+                rcq_got[k] += got;
+                if (rcq_got[k] == exp)
+                    rcq_pending--;
+            }
+            gettimeofday(&tv_now, NULL);
+        } while (rcq_pending > 0 &&
+                 TIMEVAL_SUB(tv_now, tv_round) < TE_MS2US(ROUND_TIMEOUT));
+
+        gettimeofday(&tv_now, NULL);
+        elapsed = TIMEVAL_SUB(tv_now, tv_start);
+    } while (elapsed < (uint64_t)TE_SEC2US(duration));
+    ibvts_rpcs_set_silent(pco_iut, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+
+    TEST_STEP("Report aggregate packet rate, minimum and maximum packet "
+              "rate of a QP and setup time per QP.");
+    min_pkts = max_pkts = qp_pkts[0];
+    for (k = 1; k < qp_num; k++)
+    {
+        min_pkts = MIN(min_pkts, qp_pkts[k]);
+        max_pkts = MAX(max_pkts, qp_pkts[k]);
+    }
+    RING("Sent %" PRIu64 " packets, received %" PRIu64 " packets in %"
+         PRIu64 " us, a QP got from %" PRIu64 " to %" PRIu64 " packets, "
+         "setup of %d QPs took %" PRIu64 " us", tx_pkts, rx_pkts, elapsed,
+         min_pkts, max_pkts, qp_num, setup_time);
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_meas_key(logger, NULL, "qp_num", "%d", qp_num);
+    te_mi_logger_add_meas_key(logger, NULL, "shared_cq", "%s",
+                              shared_cq ? "TRUE" : "FALSE");
+    te_mi_logger_add_meas_key(logger, NULL, "burst", "%d", burst);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          rx_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx_qp",
+                          TE_MI_MEAS_AGGR_MIN,
+                          min_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx_qp",
+                          TE_MI_MEAS_AGGR_MAX,
+                          max_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY, "qp_setup",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          (double)setup_time / qp_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    if (min_pkts == 0)
+        RING_VERDICT("Some QPs did not receive any packets");
+    else if (rx_pkts < tx_pkts)
+        RING_VERDICT("Some packets were lost");
+
+    TEST_STEP("Free all allocated resources.");
+    for (k = 0; k < qp_num; k++)
+    {
+        rpc_ibv_detach_mcast(pco_iut, iut_qp[k]->qp, &mgid[k], 0);
+        rpc_ibv_destroy_qp(pco_iut, iut_qp[k]);
+    }
+    for (k = 0; k < rcq_num; k++)
+        rpc_ibv_destroy_cq(pco_iut, iut_rcq[k]);
+    rpc_ibv_destroy_cq(pco_iut, iut_scq);
+    rpc_ibv_dereg_mr(pco_iut, iut_mr);
+    rpc_ibv_dealloc_pd(pco_iut, iut_pd);
+    rpc_ibv_close_device(pco_iut, iut_context);
+
+    ibvts_buf_pool_destroy(&tst_pool);
+    ibvts_qp_fixture_destroy(&tst_fx);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    free(tx_buf);
+    free(iut_rcq);
+    free(iut_qp);
+    free(mgid);
+    free(qp_pkts);
+    free(rx_posted);
+    free(rcq_got);
+    free(send_sge);
+    free(iut_wr);
+    free(tst_wr);
+    free(wc);
+    rpc_free(pco_iut, iut_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
@@ -0,0 +1,504 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-odp_mr On-demand paging memory regions
+ *
+ * @objective Compare registration cost, first touch latency on send and
+ *            receive and steady state packet rate of pinned memory
+ *            regions, on-demand paging memory regions and implicit
+ *            on-demand paging memory region.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param iut_mcast_addr     Multicast address for IUT
+ * @param tst_mcast_addr     Multicast address for tester
+ * @param iut_addr           Address on @p iut_if
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param mr_type            How buffers of the working set are
+ *                           registered:
+ *                           - @c pinned: MR per buffer;
+ *                           - @c odp: MR per buffer with
+ *                             @c IBV_ACCESS_ON_DEMAND;
+ *                           - @c implicit: single MR of the whole address
+ *                             space with @c IBV_ACCESS_ON_DEMAND.
+ * @param buf_num            Number of receive buffers and number of send
+ *                           buffers in the working set on IUT
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param burst              Number of WRs posted by one call of
+ *                           @b ibv_post_send()/ @b ibv_post_recv(),
+ *                           @p buf_num should be a multiple of it
+ * @param duration           Duration of steady state traffic in seconds
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note Each buffer of the working set is allocated separately and is
+ *       page aligned, so the first use of each buffer by the device
+ *       touches a new page. First touch cost is estimated as difference
+ *       of time of the first and the second pass over the working set,
+ *       time of a pass is measured by the test and includes RPC calls.
+ *       Registration time is measured on the agent. Iterations are
+ *       skipped if the device refuses ODP registration.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/odp_mr"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+#include "te_mi_log.h"
+
+#define BUF_SIZE 2048
+/** Timeout of waiting for completions of one burst, in milliseconds */
+#define BURST_TIMEOUT 1000
+/** Number of passes over the working set: the first and the second */
+#define PASS_NUM 2
+
+/** Ways to register buffers of the working set */
+typedef enum mr_kind {
+    MR_KIND_PINNED,     /**< Pinned MR per buffer */
+    MR_KIND_ODP,        /**< On-demand paging MR per buffer */
+    MR_KIND_IMPLICIT,   /**< Implicit on-demand paging MR */
+} mr_kind;
+
+/**
+ * Receive a burst of packets sent from Tester.
+ *
+ * @param pco_iut   RPC server on IUT
+ * @param iut_fx    QP fixture on IUT
+ * @param iut_wr    List of receive WRs
+ * @param pco_tst   RPC server on Tester
+ * @param tst_fx    QP fixture on Tester
+ * @param tst_wr    List of send WRs
+ * @param burst     Number of WRs in each list
+ * @param wc        Array of at least @p burst completions (OUT)
+ *
+ * @return Number of received packets or @c -1 on failure.
+ */
+static int
+rx_burst(rcf_rpc_server *pco_iut, ibvts_qp_fixture *iut_fx,
+         struct rpc_ibv_recv_wr *iut_wr, rcf_rpc_server *pco_tst,
+         ibvts_qp_fixture *tst_fx, struct rpc_ibv_send_wr *tst_wr,
+         int burst, struct rpc_ibv_wc *wc)
+{
+    struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr *tst_bad_wr = NULL;
+    int                     got;
+
+    rpc_ibv_post_recv(pco_iut, iut_fx->qp->qp, iut_wr, &iut_bad_wr);
+    rpc_ibv_post_send(pco_tst, tst_fx->qp->qp, tst_wr, &tst_bad_wr);
+
+    got = ibvts_poll_cq_wait(pco_tst, tst_fx->scq, burst, BURST_TIMEOUT, FALSE,
+                             wc, NULL);
+    if (got != burst)
+    {
+        ERROR("Only %d send WRs of %d were completed on Tester", got,
+              burst);
+        return -1;
+    }
+
+    got = ibvts_poll_cq_wait(pco_iut, iut_fx->rcq, burst, BURST_TIMEOUT, FALSE,
+                             wc, NULL);
+    if (!ibvts_check_wc(wc, got, NULL))
+        return -1;
+
+    return got;
+}
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        iut_fx;
+    ibvts_qp_fixture        tst_fx;
+    ibvts_buf_pool          tst_pool;
+
+    const struct sockaddr  *iut_mcast_addr = NULL;
+    const struct sockaddr  *tst_mcast_addr = NULL;
+    const struct sockaddr  *iut_addr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_laddr;
+
+    rpc_ptr                *iut_bufs = NULL;
+    struct rpc_ibv_mr     **iut_mrs = NULL;
+    int                     mr_num = 0;
+    int                     access;
+
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    union rpc_ibv_gid       mgid;
+
+    struct rpc_ibv_sge     *recv_sge = NULL;
+    struct rpc_ibv_sge     *iut_send_sge = NULL;
+    struct rpc_ibv_sge      tst_send_sge;
+    struct rpc_ibv_recv_wr *iut_rwr = NULL;
+    struct rpc_ibv_send_wr *iut_swr = NULL;
+    struct rpc_ibv_send_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr *tst_wr = NULL;
+    struct rpc_ibv_wc      *wc = NULL;
+
+    const char             *mr_type;
+    mr_kind                 kind;
+    int                     buf_num = 0;
+    int                     frame_len;
+    int                     burst;
+    int                     duration;
+    ibvts_buf_backing       buf_backing;
+
+    struct timeval          tv_start;
+    struct timeval          tv_now;
+    uint64_t                elapsed = 0;
+    uint64_t                reg_time = 0;
+    uint64_t                dereg_time = 0;
+    uint64_t                rx_time[PASS_NUM] = { 0, };
+    uint64_t                tx_time[PASS_NUM] = { 0, };
+    uint64_t                rx_lost[PASS_NUM] = { 0, };
+    uint64_t                lost = 0;
+    uint64_t                rx_pkts = 0;
+    int                     pass;
+    int                     got;
+    int                     i;
+    int                     j;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, iut_mcast_addr);
+    TEST_GET_ADDR(pco_tst, tst_mcast_addr);
+    TEST_GET_ADDR(pco_iut, iut_addr);
+    TEST_GET_ADDR(pco_tst, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_STRING_PARAM(mr_type);
+    TEST_GET_INT_PARAM(buf_num);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_INT_PARAM(burst);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (strcmp(mr_type, "pinned") == 0)
+        kind = MR_KIND_PINNED;
+    else if (strcmp(mr_type, "odp") == 0)
+        kind = MR_KIND_ODP;
+    else if (strcmp(mr_type, "implicit") == 0)
+        kind = MR_KIND_IMPLICIT;
+    else
+        TEST_FAIL("Incorrect value of 'mr_type' parameter");
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+    if (burst <= 0 || buf_num <= 0 || buf_num % burst != 0)
+        TEST_FAIL("'buf_num' should be a multiple of 'burst'");
+
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&iut_fx, 0, sizeof(iut_fx));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&tst_pool, 0, sizeof(tst_pool));
+
+    iut_bufs = tapi_calloc(2 * buf_num, sizeof(*iut_bufs));
+    recv_sge = tapi_calloc(buf_num, sizeof(*recv_sge));
+    iut_send_sge = tapi_calloc(buf_num, sizeof(*iut_send_sge));
+    iut_rwr = tapi_calloc(buf_num, sizeof(*iut_rwr));
+    iut_swr = tapi_calloc(buf_num, sizeof(*iut_swr));
+    tst_wr = tapi_calloc(burst, sizeof(*tst_wr));
+    wc = tapi_calloc(burst, sizeof(*wc));
+
+    TEST_STEP("Create device context, protection domain, completion "
+              "queues and @c IBV_QPT_RAW_PACKET QP with @p sq_sig_all set "
+              "to @c 1 on @p pco_iut and on @p pco_tst.");
+    fx_desc.sq_sig_all = TRUE;
+    CHECK_RC(ibvts_qp_fixture_create(pco_iut, &fx_desc, &iut_fx));
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+    if (burst > iut_fx.pool_size || burst > tst_fx.pool_size)
+        TEST_FAIL("'burst' parameter exceeds the queue size supported "
+                  "by device");
+
+    TEST_STEP("Attach QP on IUT to multicast group according to "
+              "@p iut_mcast_addr.");
+    ibvts_fill_gid(iut_mcast_addr, &mgid);
+    rpc_ibv_attach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_STEP("Allocate @p buf_num page aligned receive buffers and "
+              "@p buf_num send buffers on @p pco_iut and write raw packet "
+              "of @p frame_len length addressed to @p tst_mcast_addr to "
+              "each send buffer.");
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+    pkt_len = ibvts_create_raw_udp_dgm(iut_laddr, tst_laddr, iut_addr,
+                                       tst_mcast_addr, 0, TRUE, tx_buf,
+                                       frame_len - sizeof(te_eth_ip_udp_hdr),
+                                       packet);
+    for (i = 0; i < 2 * buf_num; i++)
+    {
+        iut_bufs[i] = rpc_memalign(pco_iut, TEST_PAGE_SIZE, BUF_SIZE);
+        if (i >= buf_num)
+            rpc_set_buf_gen(pco_iut, packet, (size_t)pkt_len, iut_bufs[i],
+                            0);
+    }
+
+    TEST_STEP("Register the buffers on @p pco_iut according to "
+              "@p mr_type measuring time spent inside @b ibv_reg_mr(). "
+              "Skip the iteration if ODP registration is refused.");
+    access = IBV_ACCESS_LOCAL_WRITE;
+    if (kind != MR_KIND_PINNED)
+        access |= IBV_ACCESS_ON_DEMAND;
+    mr_num = (kind == MR_KIND_IMPLICIT) ? 1 : 2 * buf_num;
+    iut_mrs = tapi_calloc(mr_num, sizeof(*iut_mrs));
+    for (i = 0; i < mr_num; i++)
+    {
+        if (kind != MR_KIND_PINNED)
+            RPC_AWAIT_IUT_ERROR(pco_iut);
+        if (kind == MR_KIND_IMPLICIT)
+            iut_mrs[i] = rpc_ibv_reg_mr(pco_iut, iut_fx.pd, RPC_NULL,
+                                        SIZE_MAX, access);
+        else
+            iut_mrs[i] = rpc_ibv_reg_mr(pco_iut, iut_fx.pd, iut_bufs[i],
+                                        BUF_SIZE, access);
+        if (iut_mrs[i] == NULL)
+            TEST_SKIP("IUT device does not support '%s' registration",
+                      mr_type);
+        reg_time += pco_iut->duration;
+    }
+
+    TEST_STEP("Prepare lists of @p burst receive WRs and @p burst send "
+              "WRs referring to the buffers on @p pco_iut. Create a "
+              "buffer on @p pco_tst with raw packet of @p frame_len length "
+              "addressed to @p iut_mcast_addr and prepare list of "
+              "@p burst send WRs referring to it.");
+    for (i = 0; i < buf_num; i++)
+    {
+        j = buf_num + i;
+        recv_sge[i].addr = iut_bufs[i];
+        recv_sge[i].length = BUF_SIZE;
+        recv_sge[i].lkey =
+            iut_mrs[kind == MR_KIND_IMPLICIT ? 0 : i]->lkey;
+        iut_send_sge[i].addr = iut_bufs[j];
+        iut_send_sge[i].length = pkt_len;
+        iut_send_sge[i].lkey =
+            iut_mrs[kind == MR_KIND_IMPLICIT ? 0 : j]->lkey;
+
+        iut_rwr[i].next = ((i + 1) % burst == 0) ? NULL : &iut_rwr[i + 1];
+        iut_rwr[i].sg_list = &recv_sge[i];
+        iut_rwr[i].num_sge = 1;
+        iut_rwr[i].wr_id = i;
+
+        iut_swr[i].next = ((i + 1) % burst == 0) ? NULL : &iut_swr[i + 1];
+        iut_swr[i].sg_list = &iut_send_sge[i];
+        iut_swr[i].num_sge = 1;
+        iut_swr[i].opcode = IBV_WR_SEND;
+        iut_swr[i].send_flags = IBV_SEND_IP_CSUM;
+        iut_swr[i].wr_id = i;
+    }
+
+    ibvts_buf_pool_create(pco_tst, tst_fx.pd, 1, TEST_PAGE_SIZE, BUF_SIZE,
+                          IBV_ACCESS_LOCAL_WRITE, &tst_pool);
+    pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                       iut_mcast_addr, 0, TRUE, tx_buf,
+                                       frame_len - sizeof(te_eth_ip_udp_hdr),
+                                       packet);
+    ibvts_buf_pool_write(&tst_pool, 0, packet, (size_t)pkt_len);
+    ibvts_buf_pool_sge(&tst_pool, 0, pkt_len, &tst_send_sge);
+    for (i = 0; i < burst; i++)
+    {
+        tst_wr[i].next = (i == burst - 1) ? NULL : &tst_wr[i + 1];
+        tst_wr[i].sg_list = &tst_send_sge;
+        tst_wr[i].num_sge = 1;
+        tst_wr[i].opcode = IBV_WR_SEND;
+        tst_wr[i].send_flags = IBV_SEND_IP_CSUM;
+        tst_wr[i].wr_id = i;
+    }
+
+    TEST_STEP("Twice go over all receive buffers on IUT by bursts: post "
+              "@p burst receive WRs on IUT, send @p burst packets from "
+              "Tester and wait for receive completions. Measure time of "
+              "each pass and count lost packets.");
+    ibvts_rpcs_set_silent(pco_iut, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    for (pass = 0; pass < PASS_NUM; pass++)
+    {
+        for (i = 0; i < buf_num; i += burst)
+        {
+            gettimeofday(&tv_start, NULL);
+            got = rx_burst(pco_iut, &iut_fx, &iut_rwr[i], pco_tst, &tst_fx,
+                           tst_wr, burst, wc);
+            gettimeofday(&tv_now, NULL);
+            if (got < 0)
+                TEST_VERDICT("Failed to pass a burst from Tester to IUT");
+            rx_time[pass] += TIMEVAL_SUB(tv_now, tv_start);
+            rx_lost[pass] += burst - got;
+            lost += burst - got;
+            if (lost > (uint64_t)(iut_fx.pool_size - burst))
+                TEST_VERDICT("Too many packets were lost");
+        }
+    }
+
+    TEST_STEP("Twice go over all send buffers on IUT by bursts: post "
+              "@p burst send WRs on IUT and wait for their completions. "
+              "Measure time of each pass.");
+    for (pass = 0; pass < PASS_NUM; pass++)
+    {
+        for (i = 0; i < buf_num; i += burst)
+        {
+            gettimeofday(&tv_start, NULL);
+            rpc_ibv_post_send(pco_iut, iut_fx.qp->qp, &iut_swr[i],
+                              &iut_bad_wr);
+            got = ibvts_poll_cq_wait(pco_iut, iut_fx.scq, burst,
+                                     BURST_TIMEOUT, FALSE, wc, NULL);
+            gettimeofday(&tv_now, NULL);
+            if (got != burst)
+                TEST_VERDICT("Not all send WRs were completed on IUT");
+            for (j = 0; j < got; j++)
+            {
+                if (wc[j].status != IBV_WC_SUCCESS)
+                {
+                    ERROR("Send WR completed with status %d",
+                          wc[j].status);
+                    TEST_VERDICT("Send WR completed with error on IUT");
+                }
+            }
+            tx_time[pass] += TIMEVAL_SUB(tv_now, tv_start);
+        }
+    }
+
+    TEST_STEP("During @p duration seconds keep receiving packets from "
+              "Tester going over receive buffers on IUT in round-robin "
+              "order.");
+    i = 0;
+    gettimeofday(&tv_start, NULL);
+    do {
+        got = rx_burst(pco_iut, &iut_fx, &iut_rwr[i], pco_tst, &tst_fx,
+                       tst_wr, burst, wc);
+        if (got < 0)
+            TEST_VERDICT("Failed to pass a burst from Tester to IUT");
+        rx_pkts += got;
+        lost += burst - got;
+        if (lost > (uint64_t)(iut_fx.pool_size - burst))
+            TEST_VERDICT("Too many packets were lost");
+        i = (i + burst) % buf_num;
+
+        gettimeofday(&tv_now, NULL);
+        elapsed = TIMEVAL_SUB(tv_now, tv_start);
+    } while (elapsed < (uint64_t)TE_SEC2US(duration));
+    ibvts_rpcs_set_silent(pco_iut, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+
+    TEST_STEP("Deregister MRs on @p pco_iut measuring time spent inside "
+              "@b ibv_dereg_mr().");
+    for (i = 0; i < mr_num; i++)
+    {
+        rpc_ibv_dereg_mr(pco_iut, iut_mrs[i]);
+        dereg_time += pco_iut->duration;
+        iut_mrs[i] = NULL;
+    }
+
+    TEST_STEP("Report registration and deregistration time per buffer, "
+              "time of the first and the second pass per burst, estimated "
+              "first touch cost per buffer and steady state packet rate.");
+    RING("Registration of %d buffers took %" PRIu64 " us, deregistration "
+         "%" PRIu64 " us; receive passes took %" PRIu64 " and %" PRIu64
+         " us with %" PRIu64 " and %" PRIu64 " lost packets; send passes "
+         "took %" PRIu64 " and %" PRIu64 " us", 2 * buf_num, reg_time,
+         dereg_time, rx_time[0], rx_time[1], rx_lost[0], rx_lost[1],
+         tx_time[0], tx_time[1]);
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_meas_key(logger, NULL, "mr_type", "%s", mr_type);
+    te_mi_logger_add_meas_key(logger, NULL, "buf_num", "%d", buf_num);
+    te_mi_logger_add_meas_key(logger, NULL, "frame_len", "%d", frame_len);
+    te_mi_logger_add_meas_key(logger, NULL, "burst", "%d", burst);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY, "reg_per_buf",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          (double)reg_time / (2 * buf_num),
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "dereg_per_buf", TE_MI_MEAS_AGGR_MEAN,
+                          (double)dereg_time / (2 * buf_num),
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "rx_first_pass_per_burst", TE_MI_MEAS_AGGR_MEAN,
+                          (double)rx_time[0] * burst / buf_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "rx_second_pass_per_burst", TE_MI_MEAS_AGGR_MEAN,
+                          (double)rx_time[1] * burst / buf_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "rx_first_touch_per_buf", TE_MI_MEAS_AGGR_MEAN,
+                          ((double)rx_time[0] - rx_time[1]) / buf_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "tx_first_pass_per_burst", TE_MI_MEAS_AGGR_MEAN,
+                          (double)tx_time[0] * burst / buf_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "tx_second_pass_per_burst", TE_MI_MEAS_AGGR_MEAN,
+                          (double)tx_time[1] * burst / buf_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "tx_first_touch_per_buf", TE_MI_MEAS_AGGR_MEAN,
+                          ((double)tx_time[0] - tx_time[1]) / buf_num,
+                          TE_MI_MEAS_MULTIPLIER_MICRO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          rx_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_THROUGHPUT, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          rx_pkts * pkt_len * 8 * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    if (rx_lost[0] > 0)
+        RING_VERDICT("Packets were lost on the first touch of receive "
+                     "buffers");
+    if (lost > rx_lost[0])
+        RING_VERDICT("Packets were lost after the first touch of receive "
+                     "buffers");
+
+    TEST_STEP("Free all allocated resources.");
+    rpc_ibv_detach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    for (i = 0; iut_mrs != NULL && i < mr_num; i++)
+    {
+        if (iut_mrs[i] != NULL)
+            rpc_ibv_dereg_mr(pco_iut, iut_mrs[i]);
+    }
+    for (i = 0; iut_bufs != NULL && i < 2 * buf_num; i++)
+        rpc_free(pco_iut, iut_bufs[i]);
+    ibvts_buf_pool_destroy(&tst_pool);
+    ibvts_qp_fixture_destroy(&iut_fx);
+    ibvts_qp_fixture_destroy(&tst_fx);
+    free(tx_buf);
+    free(iut_bufs);
+    free(iut_mrs);
+    free(recv_sge);
+    free(iut_send_sge);
+    free(iut_rwr);
+    free(iut_swr);
+    free(tst_wr);
+    free(wc);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
@@ -0,0 +1,277 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-poll_batch Cost of getting completions by ibv_poll_cq()
+ *
+ * @objective Measure time spent inside @b ibv_poll_cq() per receive
+ *            completion depending on number of completions requested by
+ *            one call.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param burst              Number of WRs posted by one call of
+ *                           @b ibv_post_send()/ @b ibv_post_recv()
+ * @param poll_num           Number of completions requested by one call
+ *                           of @b ibv_poll_cq()
+ * @param duration           Duration of traffic in seconds
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note Time spent inside @b ibv_poll_cq() is measured on the agent, so
+ *       it does not include RPC round trips. Only calls which returned
+ *       completions are taken into account.
+ *
+ * @note Only the classic @b ibv_poll_cq() path is measured. Comparison
+ *       with the extended CQ API (@b ibv_create_cq_ex(),
+ *       @b ibv_start_poll()/ @b ibv_next_poll()/ @b ibv_end_poll() and
+ *       per-field readers) is still open: verbs RPCs the suite is built
+ *       on do not provide it.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/poll_batch"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+#include "te_mi_log.h"
+
+#define BUF_SIZE 2048
+/** Timeout of waiting for completions of one burst, in milliseconds */
+#define BURST_TIMEOUT 1000
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        iut_fx;
+    ibvts_qp_fixture        tst_fx;
+    struct rpc_ibv_mr      *iut_mr = NULL;
+    struct rpc_ibv_mr      *tst_mr = NULL;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+
+    rpc_ptr                 iut_buffer = RPC_NULL;
+    rpc_ptr                 tst_buffer = RPC_NULL;
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    union rpc_ibv_gid       mgid;
+
+    struct rpc_ibv_sge      recv_sge;
+    struct rpc_ibv_sge      send_sge;
+    ibvts_traffic           traffic = { 0 };
+
+    int                     frame_len;
+    int                     burst;
+    int                     poll_num;
+    int                     duration;
+    ibvts_buf_backing       buf_backing;
+
+    struct timeval          tv_start;
+    struct timeval          tv_post;
+    struct timeval          tv_now;
+    uint64_t                elapsed = 0;
+    uint64_t                poll_time = 0;
+    uint64_t                poll_calls = 0;
+
+    int                     got;
+    int                     num;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_INT_PARAM(burst);
+    TEST_GET_INT_PARAM(poll_num);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+    if (poll_num < 1 || poll_num > burst)
+        TEST_FAIL("'poll_num' parameter must be in [1, burst] range");
+
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&iut_fx, 0, sizeof(iut_fx));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&recv_sge, 0, sizeof(recv_sge));
+    memset(&send_sge, 0, sizeof(send_sge));
+
+    TEST_STEP("Create buffers @p iut_buffer and @p tst_buffer on @p pco_iut "
+              "and @p pco_tst.");
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+
+    iut_buffer = rpc_memalign(pco_iut, TEST_PAGE_SIZE, BUF_SIZE);
+    tst_buffer = rpc_memalign(pco_tst, TEST_PAGE_SIZE, BUF_SIZE);
+
+    TEST_STEP("Create device context, protection domain, send and receive "
+              "completion queues and @c IBV_QPT_RAW_PACKET QP @p iut_qp "
+              "on @p pco_iut, move the QP to @c IBV_QPS_RTS state.");
+    fx_desc.max_send_sge = 1;
+    fx_desc.max_recv_sge = 1;
+    CHECK_RC(ibvts_qp_fixture_create(pco_iut, &fx_desc, &iut_fx));
+    if (burst > iut_fx.pool_size)
+        TEST_FAIL("'burst' parameter exceeds the queue size %d supported "
+                  "by IUT device", iut_fx.pool_size);
+
+    TEST_STEP("Create memory region for @p iut_buffer on @p pco_iut.");
+    iut_mr = rpc_ibv_reg_mr(pco_iut, iut_fx.pd, iut_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+
+    TEST_STEP("Create the same set of resources with @p sq_sig_all set "
+              "to @c 1 for @p tst_qp and memory region for @p tst_buffer "
+              "on @p pco_tst.");
+    fx_desc.sq_sig_all = TRUE;
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+    if (burst > tst_fx.pool_size)
+        TEST_FAIL("'burst' parameter exceeds the queue size %d supported "
+                  "by Tester device", tst_fx.pool_size);
+    tst_mr = rpc_ibv_reg_mr(pco_tst, tst_fx.pd, tst_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+
+    TEST_STEP("Attach @p iut_qp to multicast group according to "
+              "@p mcast_addr.");
+    ibvts_fill_gid(mcast_addr, &mgid);
+    rpc_ibv_attach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_STEP("Create raw multicast packet of @p frame_len length and write "
+              "it to @p tst_buffer.");
+    pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                       mcast_addr, 0, TRUE, tx_buf,
+                                       frame_len - sizeof(te_eth_ip_udp_hdr),
+                                       packet);
+    rpc_set_buf_gen(pco_tst, packet, (size_t)pkt_len, tst_buffer, 0);
+
+    TEST_STEP("Prepare lists of @p burst send WRs on @p pco_tst and receive "
+              "WRs on @p pco_iut. All send WRs refer to the same packet in "
+              "@p tst_buffer, all receive WRs refer to @p iut_buffer.");
+    recv_sge.addr = iut_buffer;
+    recv_sge.length = BUF_SIZE;
+    recv_sge.lkey = iut_mr->lkey;
+
+    send_sge.addr = tst_buffer;
+    send_sge.length = pkt_len;
+    send_sge.lkey = tst_mr->lkey;
+
+    ibvts_traffic_init(&traffic, &tst_fx, &send_sge, 1, IBV_SEND_IP_CSUM,
+                       &iut_fx, &recv_sge, 1, burst, 0);
+
+    TEST_STEP("During @p duration seconds repeat:");
+    ibvts_rpcs_set_silent(pco_iut, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    gettimeofday(&tv_start, NULL);
+    do {
+        TEST_SUBSTEP("Refill receive queue of @p iut_qp up to @p burst WRs, "
+                     "post @p burst send WRs on @p tst_qp and wait for "
+                     "their completions on @p tst_scq.");
+        rc = ibvts_traffic_send(&traffic, BURST_TIMEOUT);
+        if (rc != 0)
+            TEST_VERDICT("Send WRs were not completed successfully: %r",
+                         rc);
+
+        TEST_SUBSTEP("Get receive completions from @p iut_rcq calling "
+                     "@b ibv_poll_cq() with @p poll_num entries until "
+                     "@p burst completions are got. Sum up time spent "
+                     "inside calls which returned completions.");
+        gettimeofday(&tv_post, NULL);
+        for (got = 0; got < burst; got += num)
+        {
+            num = rpc_ibv_poll_cq(pco_iut, iut_fx.rcq,
+                                  MIN(poll_num, burst - got), traffic.wc);
+            if (num > 0)
+            {
+                poll_time += pco_iut->duration;
+                poll_calls++;
+                if (!ibvts_check_wc(traffic.wc, num, NULL))
+                    TEST_VERDICT("Receive WR completed with error");
+            }
+
+            gettimeofday(&tv_now, NULL);
+            if (TIMEVAL_SUB(tv_now, tv_post) > TE_MS2US(BURST_TIMEOUT))
+                break;
+        }
+        traffic.rx_pkts += got;
+        traffic.rx_posted -= got;
+
+        gettimeofday(&tv_now, NULL);
+        elapsed = TIMEVAL_SUB(tv_now, tv_start);
+    } while (elapsed < (uint64_t)TE_SEC2US(duration));
+    ibvts_rpcs_set_silent(pco_iut, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+
+    TEST_STEP("Report time spent inside @b ibv_poll_cq() per completion "
+              "and per call.");
+    RING("Got %" PRIu64 " completions by %" PRIu64 " ibv_poll_cq() calls "
+         "which took %" PRIu64 " us in total", traffic.rx_pkts, poll_calls,
+         poll_time);
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_meas_key(logger, NULL, "frame_len", "%d", frame_len);
+    te_mi_logger_add_meas_key(logger, NULL, "burst", "%d", burst);
+    te_mi_logger_add_meas_key(logger, NULL, "poll_num", "%d", poll_num);
+    if (traffic.rx_pkts > 0)
+    {
+        te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                              "poll_cq_per_compl", TE_MI_MEAS_AGGR_MEAN,
+                              poll_time * 1000.0 / traffic.rx_pkts,
+                              TE_MI_MEAS_MULTIPLIER_NANO);
+        te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                              "poll_cq_per_call", TE_MI_MEAS_AGGR_MEAN,
+                              poll_time * 1000.0 / poll_calls,
+                              TE_MI_MEAS_MULTIPLIER_NANO);
+    }
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    if (traffic.rx_pkts == 0)
+        TEST_VERDICT("No packets were received");
+    if (traffic.rx_pkts < traffic.tx_pkts)
+        RING_VERDICT("Some packets were lost");
+
+    TEST_STEP("Free all allocated resources.");
+    rpc_ibv_detach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    rpc_ibv_dereg_mr(pco_iut, iut_mr);
+    ibvts_qp_fixture_destroy(&iut_fx);
+
+    rpc_ibv_dereg_mr(pco_tst, tst_mr);
+    ibvts_qp_fixture_destroy(&tst_fx);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    free(tx_buf);
+    ibvts_traffic_free(&traffic);
+    rpc_free(pco_iut, iut_buffer);
+    rpc_free(pco_tst, tst_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
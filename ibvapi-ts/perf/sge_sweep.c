@@ -0,0 +1,326 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-sge_sweep Cost of gather and scatter lists of IBV_QPT_RAW_PACKET QP
+ *
+ * @objective Measure packet rate and CPU cost per WR of
+ *            @c IBV_QPT_RAW_PACKET QPs depending on number of SGEs in
+ *            send and receive WRs.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param sge_num            Number of SGEs in each send and receive WR,
+ *                           iterations with value exceeding @a max_sge
+ *                           reported by @b ibv_query_device() are
+ *                           skipped
+ * @param burst              Number of WRs posted by one call of
+ *                           @b ibv_post_send()/ @b ibv_post_recv()
+ * @param duration           Duration of traffic in seconds
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note If @p sge_num is greater than @c 1, headers of a frame are placed
+ *       in a separate buffer referred by the first SGE and payload is
+ *       split between the other SGEs. Receive SGEs have the same lengths
+ *       except for the last one which covers the rest of its buffer.
+ *       Time spent inside @b ibv_post_send() and @b ibv_post_recv() is
+ *       measured on the agents, CPU time is got by @b getrusage() for the
+ *       whole RPC servers, so it includes RPC processing.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/sge_sweep"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+#include "te_mi_log.h"
+
+#define BUF_SIZE 2048
+/** Timeout of waiting for completions of one burst, in milliseconds */
+#define BURST_TIMEOUT 1000
+
+/**
+ * Get length of a part of a frame referred by SGE.
+ *
+ * @param pkt_len   Length of the frame
+ * @param sge_num   Number of SGEs
+ * @param idx       Index of SGE
+ *
+ * @return Length of the part.
+ */
+static uint32_t
+sge_part_len(int pkt_len, int sge_num, int idx)
+{
+    int hdr_len = sizeof(te_eth_ip_udp_hdr);
+    int pld_len = pkt_len - hdr_len;
+
+    if (sge_num == 1)
+        return pkt_len;
+    if (idx == 0)
+        return hdr_len;
+
+    idx--;
+    sge_num--;
+    return pld_len / sge_num + (idx < pld_len % sge_num ? 1 : 0);
+}
+
+/**
+ * Get maximum number of SGEs in WR supported by device.
+ *
+ * @param rpcs      RPC server handler
+ *
+ * @return Value of @a max_sge reported by @b ibv_query_device().
+ */
+static int
+get_max_sge(rcf_rpc_server *rpcs)
+{
+    struct rpc_ibv_context     *context;
+    struct rpc_ibv_device_attr  attr;
+    int                         port;
+
+    context = rpc_ibv_open_device(rpcs, &port);
+    rpc_ibv_query_device(rpcs, context->context, &attr);
+    rpc_ibv_close_device(rpcs, context);
+
+    return attr.max_sge;
+}
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        iut_fx;
+    ibvts_qp_fixture        tst_fx;
+    ibvts_buf_pool          iut_pool;
+    ibvts_buf_pool          tst_pool;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    union rpc_ibv_gid       mgid;
+
+    struct rpc_ibv_sge     *recv_sge = NULL;
+    struct rpc_ibv_sge     *send_sge = NULL;
+    ibvts_traffic           traffic = { 0 };
+
+    int                     frame_len;
+    int                     sge_num;
+    int                     iut_max_sge;
+    int                     tst_max_sge;
+    int                     burst;
+    int                     duration;
+    ibvts_buf_backing       buf_backing;
+
+    tarpc_rusage            iut_ru_start;
+    tarpc_rusage            iut_ru_end;
+    tarpc_rusage            tst_ru_start;
+    tarpc_rusage            tst_ru_end;
+    uint64_t                iut_cpu_time;
+    uint64_t                tst_cpu_time;
+
+    int                     i;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_INT_PARAM(sge_num);
+    TEST_GET_INT_PARAM(burst);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+    if (sge_num < 1 ||
+        (sge_num > 1 &&
+         frame_len - (int)sizeof(te_eth_ip_udp_hdr) < sge_num - 1))
+        TEST_FAIL("Incorrect value of 'sge_num' parameter");
+
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&iut_fx, 0, sizeof(iut_fx));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&iut_pool, 0, sizeof(iut_pool));
+    memset(&tst_pool, 0, sizeof(tst_pool));
+
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+
+    TEST_STEP("Skip the iteration if @p sge_num exceeds @a max_sge "
+              "reported by @b ibv_query_device() on @p pco_iut or "
+              "@p pco_tst.");
+    iut_max_sge = get_max_sge(pco_iut);
+    tst_max_sge = get_max_sge(pco_tst);
+    RING("max_sge is %d on IUT and %d on Tester", iut_max_sge, tst_max_sge);
+    if (sge_num > iut_max_sge || sge_num > tst_max_sge)
+        TEST_SKIP("'sge_num' exceeds max_sge supported by device");
+
+    TEST_STEP("Create device context, protection domain, completion "
+              "queues and @c IBV_QPT_RAW_PACKET QP @p iut_qp with "
+              "@p sge_num receive SGEs on @p pco_iut and the same set of "
+              "resources with @p sge_num send SGEs and @p sq_sig_all set "
+              "to @c 1 for @p tst_qp on @p pco_tst.");
+    fx_desc.max_send_sge = sge_num;
+    fx_desc.max_recv_sge = sge_num;
+    CHECK_RC(ibvts_qp_fixture_create(pco_iut, &fx_desc, &iut_fx));
+    fx_desc.sq_sig_all = TRUE;
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+    if (burst > iut_fx.pool_size || burst > tst_fx.pool_size)
+        TEST_FAIL("'burst' parameter exceeds the queue size supported "
+                  "by device");
+
+    TEST_STEP("Allocate and register @p sge_num buffers on @p pco_iut and "
+              "@p pco_tst.");
+    ibvts_buf_pool_create(pco_iut, iut_fx.pd, sge_num, TEST_PAGE_SIZE,
+                          BUF_SIZE, IBV_ACCESS_LOCAL_WRITE, &iut_pool);
+    ibvts_buf_pool_create(pco_tst, tst_fx.pd, sge_num, TEST_PAGE_SIZE,
+                          BUF_SIZE, IBV_ACCESS_LOCAL_WRITE, &tst_pool);
+
+    TEST_STEP("Attach @p iut_qp to multicast group according to "
+              "@p mcast_addr.");
+    ibvts_fill_gid(mcast_addr, &mgid);
+    rpc_ibv_attach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_STEP("Prepare send and receive SGE lists referring to the "
+              "buffers, create raw multicast packet of @p frame_len length "
+              "and write it to Tester buffers according to send SGE "
+              "list.");
+    recv_sge = tapi_calloc(sge_num, sizeof(*recv_sge));
+    send_sge = tapi_calloc(sge_num, sizeof(*send_sge));
+
+    pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                       mcast_addr, 0, TRUE, tx_buf,
+                                       frame_len - sizeof(te_eth_ip_udp_hdr),
+                                       packet);
+    for (i = 0; i < sge_num; i++)
+    {
+        ibvts_buf_pool_sge(&tst_pool, i, sge_part_len(pkt_len, sge_num, i),
+                           &send_sge[i]);
+        ibvts_buf_pool_sge(&iut_pool, i,
+                           i == sge_num - 1 ? BUF_SIZE :
+                                sge_part_len(pkt_len, sge_num, i),
+                           &recv_sge[i]);
+    }
+
+    TEST_STEP("Prepare lists of @p burst send WRs on @p pco_tst and receive "
+              "WRs on @p pco_iut. All send WRs refer to the same send SGE "
+              "list, all receive WRs refer to the same receive SGE list.");
+    ibvts_traffic_init(&traffic, &tst_fx, send_sge, sge_num,
+                       IBV_SEND_IP_CSUM, &iut_fx, recv_sge, sge_num,
+                       burst, 0);
+    ibvts_upload_burst(pco_tst, packet, traffic.send_wr, 1);
+
+    TEST_STEP("Get resource usage of @p pco_iut and @p pco_tst "
+              "processes.");
+    rpc_getrusage(pco_iut, RPC_RUSAGE_SELF, &iut_ru_start);
+    rpc_getrusage(pco_tst, RPC_RUSAGE_SELF, &tst_ru_start);
+
+    TEST_STEP("During @p duration seconds repeat: refill receive queue "
+              "of @p iut_qp up to @p burst WRs, post @p burst send WRs on "
+              "@p tst_qp, wait for their completions on @p tst_scq and "
+              "for receive completions on @p iut_rcq.");
+    rc = ibvts_traffic_run(&traffic, duration, BURST_TIMEOUT);
+    if (rc != 0)
+        TEST_VERDICT("Burst of WRs was not completed successfully: %r", rc);
+
+    rpc_getrusage(pco_iut, RPC_RUSAGE_SELF, &iut_ru_end);
+    rpc_getrusage(pco_tst, RPC_RUSAGE_SELF, &tst_ru_end);
+    iut_cpu_time = ibvts_rusage_cpu_time(&iut_ru_start, &iut_ru_end);
+    tst_cpu_time = ibvts_rusage_cpu_time(&tst_ru_start, &tst_ru_end);
+
+    if (traffic.rx_pkts == 0)
+        TEST_VERDICT("No packets were received");
+
+    TEST_STEP("Report packet rates, time spent inside posting functions "
+              "per WR and CPU time per WR of @p pco_tst and @p pco_iut.");
+    RING("Sent %" PRIu64 " packets, received %" PRIu64 " packets in %"
+         PRIu64 " us, ibv_post_send() took %" PRIu64 " us, "
+         "ibv_post_recv() took %" PRIu64 " us, CPU time %" PRIu64
+         " us on Tester and %" PRIu64 " us on IUT",
+         traffic.tx_pkts, traffic.rx_pkts, traffic.elapsed,
+         traffic.post_send_time, traffic.post_recv_time, tst_cpu_time,
+         iut_cpu_time);
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_meas_key(logger, NULL, "frame_len", "%d", frame_len);
+    te_mi_logger_add_meas_key(logger, NULL, "sge_num", "%d", sge_num);
+    te_mi_logger_add_meas_key(logger, NULL, "burst", "%d", burst);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "tx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          traffic.tx_pkts * 1000000.0 / traffic.elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          traffic.rx_pkts * 1000000.0 / traffic.elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_THROUGHPUT, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          traffic.rx_bytes * 8 * 1000000.0 / traffic.elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "post_send_per_wr", TE_MI_MEAS_AGGR_MEAN,
+                          traffic.post_send_time * 1000.0 / traffic.tx_pkts,
+                          TE_MI_MEAS_MULTIPLIER_NANO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "post_recv_per_wr", TE_MI_MEAS_AGGR_MEAN,
+                          traffic.post_recv_time * 1000.0 / traffic.rx_pkts,
+                          TE_MI_MEAS_MULTIPLIER_NANO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "tst_cpu_per_wr", TE_MI_MEAS_AGGR_MEAN,
+                          tst_cpu_time * 1000.0 / traffic.tx_pkts,
+                          TE_MI_MEAS_MULTIPLIER_NANO);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                          "iut_cpu_per_wr", TE_MI_MEAS_AGGR_MEAN,
+                          iut_cpu_time * 1000.0 / traffic.rx_pkts,
+                          TE_MI_MEAS_MULTIPLIER_NANO);
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    if (traffic.rx_pkts < traffic.tx_pkts)
+        RING_VERDICT("Some packets were lost");
+
+    TEST_STEP("Free all allocated resources.");
+    rpc_ibv_detach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    ibvts_buf_pool_destroy(&iut_pool);
+    ibvts_buf_pool_destroy(&tst_pool);
+    ibvts_qp_fixture_destroy(&iut_fx);
+    ibvts_qp_fixture_destroy(&tst_fx);
+    free(tx_buf);
+    free(recv_sge);
+    free(send_sge);
+    ibvts_traffic_free(&traffic);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
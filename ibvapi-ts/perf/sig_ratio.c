@@ -0,0 +1,310 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-sig_ratio Packet rate with selective signaling of send WRs
+ *
+ * @objective Measure packet rate of @c IBV_QPT_RAW_PACKET QP and cost of
+ *            polling send CQ when only one of every @p sig_every send
+ *            WRs is signaled.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param burst              Number of WRs posted by one call of
+ *                           @b ibv_post_send()
+ * @param sig_every          @c IBV_SEND_SIGNALED is set in one of every
+ *                           @p sig_every send WRs, it must divide
+ *                           @p burst
+ * @param duration           Duration of traffic in seconds
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note Sending is not synchronized with completions: bursts are posted
+ *       while there is room for them in the send queue. A completion of
+ *       a signaled WR frees the queue entries of it and of all unsignaled
+ *       WRs posted before it, so the number of outstanding WRs is
+ *       @p sig_every times the number of signaled WRs without completion.
+ *       Time spent inside @b ibv_poll_cq() on the send CQ is measured on
+ *       the agent. Receive queue of IUT is refilled by the test, so IUT
+ *       may drop some packets; their number is logged.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/sig_ratio"
+
+#include "ibvapi-test.h"
+#include "tapi_mem.h"
+#include "te_mi_log.h"
+
+#define BUF_SIZE 2048
+/** Timeout of waiting for completions of one burst, in milliseconds */
+#define BURST_TIMEOUT 1000
+
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        iut_fx;
+    ibvts_qp_fixture        tst_fx;
+    struct rpc_ibv_mr      *iut_mr = NULL;
+    struct rpc_ibv_mr      *tst_mr = NULL;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+
+    rpc_ptr                 iut_buffer = RPC_NULL;
+    rpc_ptr                 tst_buffer = RPC_NULL;
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    union rpc_ibv_gid       mgid;
+
+    struct rpc_ibv_sge      recv_sge;
+    struct rpc_ibv_sge      send_sge;
+    struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr *tst_bad_wr = NULL;
+    ibvts_traffic           traffic = { 0 };
+
+    int                     frame_len;
+    int                     burst;
+    int                     sig_every;
+    int                     duration;
+    ibvts_buf_backing       buf_backing;
+
+    struct timeval          tv_start;
+    struct timeval          tv_now;
+    uint64_t                elapsed = 0;
+    uint64_t                poll_time = 0;
+    uint64_t                poll_calls = 0;
+
+    uint64_t                tx_pkts = 0;
+    uint64_t                rx_pkts = 0;
+    int                     outstanding = 0;
+    int                     rx_posted = 0;
+    int                     got;
+    int                     i;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_INT_PARAM(burst);
+    TEST_GET_INT_PARAM(sig_every);
+    TEST_GET_INT_PARAM(duration);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+    if (sig_every < 1 || burst % sig_every != 0)
+        TEST_FAIL("'sig_every' parameter must divide 'burst'");
+
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&iut_fx, 0, sizeof(iut_fx));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&recv_sge, 0, sizeof(recv_sge));
+    memset(&send_sge, 0, sizeof(send_sge));
+
+    TEST_STEP("Create buffers @p iut_buffer and @p tst_buffer on @p pco_iut "
+              "and @p pco_tst.");
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+
+    iut_buffer = rpc_memalign(pco_iut, TEST_PAGE_SIZE, BUF_SIZE);
+    tst_buffer = rpc_memalign(pco_tst, TEST_PAGE_SIZE, BUF_SIZE);
+
+    TEST_STEP("Create device context, protection domain, send and receive "
+              "completion queues and @c IBV_QPT_RAW_PACKET QP @p iut_qp "
+              "with the maximum queue size on @p pco_iut and the same set "
+              "of resources with @p sq_sig_all set to @c 0 for @p tst_qp "
+              "on @p pco_tst. Move the QPs to @c IBV_QPS_RTS state.");
+    fx_desc.max_send_sge = 1;
+    fx_desc.max_recv_sge = 1;
+    CHECK_RC(ibvts_qp_fixture_create(pco_iut, &fx_desc, &iut_fx));
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+    if (burst > iut_fx.pool_size || burst > tst_fx.pool_size)
+        TEST_FAIL("'burst' parameter exceeds the queue size supported "
+                  "by device");
+
+    TEST_STEP("Create memory regions for @p iut_buffer and @p tst_buffer.");
+    iut_mr = rpc_ibv_reg_mr(pco_iut, iut_fx.pd, iut_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+    tst_mr = rpc_ibv_reg_mr(pco_tst, tst_fx.pd, tst_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+
+    TEST_STEP("Attach @p iut_qp to multicast group according to "
+              "@p mcast_addr.");
+    ibvts_fill_gid(mcast_addr, &mgid);
+    rpc_ibv_attach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_STEP("Create raw multicast packet of @p frame_len length and write "
+              "it to @p tst_buffer.");
+    pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                       mcast_addr, 0, TRUE, tx_buf,
+                                       frame_len - sizeof(te_eth_ip_udp_hdr),
+                                       packet);
+    rpc_set_buf_gen(pco_tst, packet, (size_t)pkt_len, tst_buffer, 0);
+
+    TEST_STEP("Prepare lists of @p burst send WRs on @p pco_tst and receive "
+              "WRs on @p pco_iut. Set @c IBV_SEND_SIGNALED in every "
+              "@p sig_every send WR, so the last WR of the list is always "
+              "signaled.");
+    recv_sge.addr = iut_buffer;
+    recv_sge.length = BUF_SIZE;
+    recv_sge.lkey = iut_mr->lkey;
+
+    send_sge.addr = tst_buffer;
+    send_sge.length = pkt_len;
+    send_sge.lkey = tst_mr->lkey;
+
+    ibvts_traffic_init(&traffic, &tst_fx, &send_sge, 1, IBV_SEND_IP_CSUM,
+                       &iut_fx, &recv_sge, 1, burst, 0);
+    for (i = sig_every - 1; i < burst; i += sig_every)
+        traffic.send_wr[i].send_flags |= IBV_SEND_SIGNALED;
+
+    TEST_STEP("Fill receive queue of @p iut_qp.");
+    while (rx_posted + burst <= iut_fx.pool_size)
+    {
+        rpc_ibv_post_recv(pco_iut, iut_fx.qp->qp, traffic.recv_wr,
+                          &iut_bad_wr);
+        rx_posted += burst;
+    }
+
+    TEST_STEP("During @p duration seconds repeat:");
+    ibvts_rpcs_set_silent(pco_iut, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    gettimeofday(&tv_start, NULL);
+    do {
+        TEST_SUBSTEP("If there is room for @p burst WRs in send queue of "
+                     "@p tst_qp, post them.");
+        if (outstanding + burst <= tst_fx.pool_size)
+        {
+            rpc_ibv_post_send(pco_tst, tst_fx.qp->qp, traffic.send_wr,
+                              &tst_bad_wr);
+            outstanding += burst;
+            tx_pkts += burst;
+        }
+
+        TEST_SUBSTEP("Call @b ibv_poll_cq() once on @p tst_scq, sum up "
+                     "time spent inside it and release @p sig_every "
+                     "send queue entries per got completion.");
+        got = rpc_ibv_poll_cq(pco_tst, tst_fx.scq, burst / sig_every,
+                              traffic.wc);
+        poll_time += pco_tst->duration;
+        poll_calls++;
+        if (!ibvts_check_wc(traffic.wc, got, NULL))
+            TEST_VERDICT("Send WR completed with error");
+        outstanding -= got * sig_every;
+
+        TEST_SUBSTEP("Get available receive completions on @p iut_rcq and "
+                     "post the same number of receive WRs.");
+        got = rpc_ibv_poll_cq(pco_iut, iut_fx.rcq, burst, traffic.wc);
+        if (!ibvts_check_wc(traffic.wc, got, NULL))
+            TEST_VERDICT("Receive WR completed with error");
+        if (got > 0)
+        {
+            rpc_ibv_post_recv(pco_iut, iut_fx.qp->qp,
+                              &traffic.recv_wr[burst - got], &iut_bad_wr);
+        }
+        rx_pkts += got;
+
+        gettimeofday(&tv_now, NULL);
+        elapsed = TIMEVAL_SUB(tv_now, tv_start);
+    } while (elapsed < (uint64_t)TE_SEC2US(duration));
+    ibvts_rpcs_set_silent(pco_iut, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+
+    TEST_STEP("Wait for completions of all outstanding signaled send WRs "
+              "and for the rest of receive completions.");
+    while (outstanding > 0)
+    {
+        got = ibvts_poll_cq_wait(pco_tst, tst_fx.scq,
+                                 MIN(outstanding, burst) / sig_every,
+                                 BURST_TIMEOUT, FALSE, traffic.wc, NULL);
+        if (!ibvts_check_wc(traffic.wc, got, NULL) || got == 0)
+            TEST_VERDICT("Not all send WRs were completed successfully");
+        outstanding -= got * sig_every;
+    }
+    do {
+        got = ibvts_poll_cq_wait(pco_iut, iut_fx.rcq, burst, BURST_TIMEOUT,
+                                 FALSE, traffic.wc, NULL);
+        rx_pkts += got;
+    } while (got == burst);
+
+    TEST_STEP("Report packet rate of sent and received traffic and time "
+              "spent inside @b ibv_poll_cq() on @p tst_scq per sent WR.");
+    RING("Sent %" PRIu64 " packets, received %" PRIu64 " packets in %"
+         PRIu64 " us, %" PRIu64 " ibv_poll_cq() calls on send CQ took %"
+         PRIu64 " us in total", tx_pkts, rx_pkts, elapsed, poll_calls,
+         poll_time);
+
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    ibvts_mi_add_rpc_note(logger);
+    te_mi_logger_add_meas_key(logger, NULL, "frame_len", "%d", frame_len);
+    te_mi_logger_add_meas_key(logger, NULL, "burst", "%d", burst);
+    te_mi_logger_add_meas_key(logger, NULL, "sig_every", "%d", sig_every);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "tx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          tx_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_PPS, "rx",
+                          TE_MI_MEAS_AGGR_MEAN,
+                          rx_pkts * 1000000.0 / elapsed,
+                          TE_MI_MEAS_MULTIPLIER_PLAIN);
+    if (tx_pkts > 0)
+    {
+        te_mi_logger_add_meas(logger, NULL, TE_MI_MEAS_LATENCY,
+                              "send_poll_cq_per_wr", TE_MI_MEAS_AGGR_MEAN,
+                              poll_time * 1000.0 / tx_pkts,
+                              TE_MI_MEAS_MULTIPLIER_NANO);
+    }
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    if (rx_pkts == 0)
+        TEST_VERDICT("No packets were received");
+    if (rx_pkts < tx_pkts)
+        RING("%" PRIu64 " packets were dropped by IUT", tx_pkts - rx_pkts);
+
+    TEST_STEP("Free all allocated resources.");
+    rpc_ibv_detach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    rpc_ibv_dereg_mr(pco_iut, iut_mr);
+    ibvts_qp_fixture_destroy(&iut_fx);
+
+    rpc_ibv_dereg_mr(pco_tst, tst_mr);
+    ibvts_qp_fixture_destroy(&tst_fx);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    free(tx_buf);
+    ibvts_traffic_free(&traffic);
+    rpc_free(pco_iut, iut_buffer);
+    rpc_free(pco_tst, tst_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
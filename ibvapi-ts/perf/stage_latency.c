@@ -0,0 +1,211 @@
+/* SPDX-License-Identifier: Apache-2.0
+ * Copyright (C) 2012-2022 OKTET Labs Ltd.
+ */
+/** @page perf-stage_latency Time spent inside ibv_post_send() of IBV_QPT_RAW_PACKET QP
+ *
+ * @objective Measure time spent inside @b ibv_post_send() when frames
+ *            are sent one by one, each after the previous one is
+ *            received by the peer.
+ *
+ * @type performance
+ *
+ * @param pco_iut            PCO on IUT
+ * @param pco_tst            PCO on Tester
+ * @param mcast_addr         Multicast address
+ * @param tst_addr           Address on @p tst_if
+ * @param iut_laddr          Hardware address of @p iut_if
+ * @param tst_laddr          Hardware address of @p tst_if
+ * @param frame_len          Length of Ethernet frame to be sent
+ * @param iter_num           Number of frames to send
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
+ *
+ * @note Only time spent inside @b ibv_post_send() is reported; it is
+ *       measured on Tester agent and does not include RPC round trips.
+ *       Breakdown of latency into stages (posting till send completion,
+ *       send completion till receive completion) is not provided: it
+ *       needs completion timestamps which are not available via RPC,
+ *       and timing by the test or by clocks of two agents is dominated
+ *       by RPC round trips.
+ *
+ * @par Scenario:
+ */
+
+#define TE_TEST_NAME  "perf/stage_latency"
+
+#include "ibvapi-test.h"
+
+#define BUF_SIZE 2048
+int
+main(int argc, char *argv[])
+{
+    rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
+    rcf_rpc_server     *pco_tst = NULL;
+
+    ibvts_qp_fixture_desc   fx_desc;
+    ibvts_qp_fixture        iut_fx;
+    ibvts_qp_fixture        tst_fx;
+    struct rpc_ibv_mr      *iut_mr = NULL;
+    struct rpc_ibv_mr      *tst_mr = NULL;
+
+    const struct sockaddr  *iut_laddr;
+    const struct sockaddr  *tst_addr;
+    const struct sockaddr  *tst_laddr;
+    const struct sockaddr  *mcast_addr = NULL;
+
+    rpc_ptr                 iut_buffer = RPC_NULL;
+    rpc_ptr                 tst_buffer = RPC_NULL;
+    void                   *tx_buf = NULL;
+    uint8_t                 packet[BUF_SIZE];
+    int                     pkt_len;
+
+    union rpc_ibv_gid       mgid;
+
+    struct rpc_ibv_sge      recv_sge;
+    struct rpc_ibv_sge      send_sge;
+    struct rpc_ibv_recv_wr  iut_wr;
+    struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
+    struct rpc_ibv_send_wr  tst_wr;
+    struct rpc_ibv_send_wr *tst_bad_wr = NULL;
+    struct rpc_ibv_wc       wc;
+
+    int                     frame_len;
+    int                     iter_num;
+    ibvts_buf_backing       buf_backing;
+
+    ibvts_hist              post_hist;
+    int                     i;
+
+    te_mi_logger           *logger = NULL;
+
+    TEST_START;
+    TEST_GET_IBV_PCO(pco_tst);
+    TEST_GET_IBV_PCO(pco_iut);
+    TEST_GET_ADDR(pco_iut, mcast_addr);
+    TEST_GET_ADDR(pco_iut, tst_addr);
+    TEST_GET_LINK_ADDR(iut_laddr);
+    TEST_GET_LINK_ADDR(tst_laddr);
+    TEST_GET_INT_PARAM(frame_len);
+    TEST_GET_INT_PARAM(iter_num);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
+
+    if (frame_len < (int)sizeof(te_eth_ip_udp_hdr) || frame_len > BUF_SIZE)
+        TEST_FAIL("Incorrect value of 'frame_len' parameter");
+
+    memset(&fx_desc, 0, sizeof(fx_desc));
+    memset(&iut_fx, 0, sizeof(iut_fx));
+    memset(&tst_fx, 0, sizeof(tst_fx));
+    memset(&recv_sge, 0, sizeof(recv_sge));
+    memset(&send_sge, 0, sizeof(send_sge));
+    memset(&iut_wr, 0, sizeof(iut_wr));
+    memset(&tst_wr, 0, sizeof(tst_wr));
+    ibvts_hist_init(&post_hist);
+
+    TEST_STEP("Create buffers @p iut_buffer and @p tst_buffer on @p pco_iut "
+              "and @p pco_tst.");
+    tx_buf = te_make_buf_by_len(BUF_SIZE);
+    te_fill_buf(tx_buf, BUF_SIZE);
+
+    iut_buffer = rpc_memalign(pco_iut, TEST_PAGE_SIZE, BUF_SIZE);
+    tst_buffer = rpc_memalign(pco_tst, TEST_PAGE_SIZE, BUF_SIZE);
+
+    TEST_STEP("Create @c IBV_QPT_RAW_PACKET QP @p iut_qp on @p pco_iut and "
+              "@c IBV_QPT_RAW_PACKET QP @p tst_qp with @p sq_sig_all set "
+              "to @c 1 on @p pco_tst. Move the QPs to @c IBV_QPS_RTS "
+              "state.");
+    fx_desc.max_send_sge = 1;
+    fx_desc.max_recv_sge = 1;
+    fx_desc.sq_sig_all = TRUE;
+    CHECK_RC(ibvts_qp_fixture_create(pco_iut, &fx_desc, &iut_fx));
+    CHECK_RC(ibvts_qp_fixture_create(pco_tst, &fx_desc, &tst_fx));
+
+    TEST_STEP("Create memory regions for @p iut_buffer and @p tst_buffer.");
+    iut_mr = rpc_ibv_reg_mr(pco_iut, iut_fx.pd, iut_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+    tst_mr = rpc_ibv_reg_mr(pco_tst, tst_fx.pd, tst_buffer, BUF_SIZE,
+                            IBV_ACCESS_LOCAL_WRITE);
+
+    TEST_STEP("Attach @p iut_qp to multicast group according to "
+              "@p mcast_addr.");
+    ibvts_fill_gid(mcast_addr, &mgid);
+    rpc_ibv_attach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    TEST_STEP("Create raw multicast packet of @p frame_len length and write "
+              "it to @p tst_buffer.");
+    pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
+                                       mcast_addr, 0, TRUE, tx_buf,
+                                       frame_len - sizeof(te_eth_ip_udp_hdr),
+                                       packet);
+    rpc_set_buf_gen(pco_tst, packet, (size_t)pkt_len, tst_buffer, 0);
+
+    recv_sge.addr = iut_buffer;
+    recv_sge.length = BUF_SIZE;
+    recv_sge.lkey = iut_mr->lkey;
+    iut_wr.sg_list = &recv_sge;
+    iut_wr.num_sge = 1;
+
+    send_sge.addr = tst_buffer;
+    send_sge.length = pkt_len;
+    send_sge.lkey = tst_mr->lkey;
+    tst_wr.sg_list = &send_sge;
+    tst_wr.num_sge = 1;
+    tst_wr.opcode = IBV_WR_SEND;
+    tst_wr.send_flags = IBV_SEND_IP_CSUM;
+
+    TEST_STEP("Repeat @p iter_num times:");
+    ibvts_rpcs_set_silent(pco_iut, TRUE);
+    ibvts_rpcs_set_silent(pco_tst, TRUE);
+    for (i = 0; i < iter_num; i++)
+    {
+        TEST_SUBSTEP("Post receive WR on @p iut_qp and send WR on "
+                     "@p tst_qp. Add time spent inside @b ibv_post_send() "
+                     "on @p pco_tst agent to posting histogram.");
+        rpc_ibv_post_recv(pco_iut, iut_fx.qp->qp, &iut_wr, &iut_bad_wr);
+        rpc_ibv_post_send(pco_tst, tst_fx.qp->qp, &tst_wr, &tst_bad_wr);
+        ibvts_hist_add(&post_hist, pco_tst->duration);
+
+        TEST_SUBSTEP("Wait for send completion on @p tst_scq and receive "
+                     "completion on @p iut_rcq.");
+        if (ibvts_poll_cq_wait(pco_tst, tst_fx.scq, 1, TEST_COMPL_TIMEOUT,
+                               FALSE, &wc, NULL) != 1 ||
+            !ibvts_check_wc(&wc, 1, NULL))
+            TEST_VERDICT("Send WR was not completed successfully");
+        if (ibvts_poll_cq_wait(pco_iut, iut_fx.rcq, 1, TEST_COMPL_TIMEOUT,
+                               FALSE, &wc, NULL) != 1 ||
+            !ibvts_check_wc(&wc, 1, NULL))
+            TEST_VERDICT("Receive WR was not completed successfully");
+    }
+    ibvts_rpcs_set_silent(pco_iut, FALSE);
+    ibvts_rpcs_set_silent(pco_tst, FALSE);
+
+    TEST_STEP("Log histogram of time spent inside @b ibv_post_send().");
+    CHECK_RC(te_mi_logger_meas_create("ibvapi-ts", &logger));
+    te_mi_logger_add_meas_key(logger, NULL, "frame_len", "%d", frame_len);
+    ibvts_hist_log(&post_hist, logger, TE_MI_MEAS_LATENCY, "post_send",
+                   TE_MI_MEAS_MULTIPLIER_MICRO, FALSE);
+    te_mi_logger_destroy(logger);
+    logger = NULL;
+
+    TEST_STEP("Free all allocated resources.");
+    rpc_ibv_detach_mcast(pco_iut, iut_fx.qp->qp, &mgid, 0);
+
+    rpc_ibv_dereg_mr(pco_iut, iut_mr);
+    ibvts_qp_fixture_destroy(&iut_fx);
+
+    rpc_ibv_dereg_mr(pco_tst, tst_mr);
+    ibvts_qp_fixture_destroy(&tst_fx);
+
+    TEST_SUCCESS;
+
+cleanup:
+    if (logger != NULL)
+        te_mi_logger_destroy(logger);
+    free(tx_buf);
+    rpc_free(pco_iut, iut_buffer);
+    rpc_free(pco_tst, tst_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
+
+    TEST_END;
+}
@@ -23,6 +23,9 @@
  * @param two_contexts       If it is @c TRUE create CQs with different
  *                           contexts
  * @param comp_wr            Describes which WR should be posted
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
  *
  * @author Yurij Plotnikov <Yurij.Plotnikov@oktetlabs.ru>
  *
@@ -41,6 +44,7 @@ int
 main(int argc, char *argv[])
 {
     rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
     rcf_rpc_server     *pco_tst = NULL;
 
     struct rpc_ibv_context *iut_context = NULL;
@@ -74,6 +78,8 @@ main(int argc, char *argv[])
 
     int                    ev_num1 = 0;
     int                    ev_num2 = 0;
+    int                    exp_num1;
+    int                    exp_num2;
 
     const struct sockaddr  *iut_laddr;
     const struct sockaddr  *tst_addr;
@@ -109,6 +115,7 @@ main(int argc, char *argv[])
     te_bool                 two_notify_calls;
     te_bool                 two_contexts;
     const char             *comp_wr;
+    ibvts_buf_backing       buf_backing;
 
     rpc_ptr                 cq_context1;
     rpc_ptr                 cq_context2;
@@ -128,6 +135,7 @@ main(int argc, char *argv[])
     TEST_GET_BOOL_PARAM(two_notify_calls);
     TEST_GET_BOOL_PARAM(two_contexts);
     TEST_GET_STRING_PARAM(comp_wr);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
 
     TEST_STEP("Create two buffers @p iut_recv_buffer and @p iut_send_buffer "
               "on @p pco_iut.");
@@ -359,20 +367,27 @@ main(int argc, char *argv[])
                           &iut_send_bad_wr);
     }
 
-    TEST_STEP("Call @b ibv_poll_cq() on one or two CQs and check it returns "
-              "correct number of events.");
-    ev_num1 = rpc_ibv_poll_cq(pco_iut, iut_cq1, MAX_WC_NUM, wc);
-    if (!((!two_cq && (strcmp(comp_wr, "recv") == 0 ||
-                       strcmp(comp_wr, "send") == 0) && ev_num1 == 1) ||
-          (!two_cq && strcmp(comp_wr, "both") == 0 && ev_num1 == 2) ||
-          (two_cq && strcmp(comp_wr, "send") != 0 && ev_num1 == 1) ||
-          (two_cq && strcmp(comp_wr, "send") == 0 && ev_num1 == 0)))
+    TEST_STEP("Call @b ibv_poll_cq() on one or two CQs until completions "
+              "of all posted WRs are reported and check it returns correct "
+              "number of events.");
+    if (two_cq)
+        exp_num1 = (strcmp(comp_wr, "send") == 0) ? 0 : 1;
+    else
+        exp_num1 = (strcmp(comp_wr, "both") == 0) ? 2 : 1;
+    ev_num1 = ibvts_poll_cq_wait(pco_iut, iut_cq1, exp_num1,
+                                 TEST_COMPL_TIMEOUT, TRUE, wc, NULL);
+    ev_num1 += rpc_ibv_poll_cq(pco_iut, iut_cq1, MAX_WC_NUM - ev_num1,
+                               wc + ev_num1);
+    if (ev_num1 != exp_num1)
         RING_VERDICT("Incorrect number of events on the first CQ.");
     if (two_cq)
     {
-        ev_num2 = rpc_ibv_poll_cq(pco_iut, iut_cq2, MAX_WC_NUM, wc);
-        if (!((strcmp(comp_wr, "recv") != 0 && ev_num2 == 1) ||
-              (strcmp(comp_wr, "recv") == 0 && ev_num2 == 0)))
+        exp_num2 = (strcmp(comp_wr, "recv") == 0) ? 0 : 1;
+        ev_num2 = ibvts_poll_cq_wait(pco_iut, iut_cq2, exp_num2,
+                                     TEST_COMPL_TIMEOUT, TRUE, wc, NULL);
+        ev_num2 += rpc_ibv_poll_cq(pco_iut, iut_cq2, MAX_WC_NUM - ev_num2,
+                                   wc + ev_num2);
+        if (ev_num2 != exp_num2)
             RING_VERDICT("Incorrect number of events on the second CQ.");
     }
 
@@ -437,6 +452,7 @@ cleanup:
     rpc_free(pco_iut, cq_context1);
     rpc_free(pco_iut, cq_context2);
     rpc_free(pco_tst, tst_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
 
     TEST_END;
 }
@@ -15,7 +15,9 @@
  * @param tst_addr           Address on @p tst_if
  * @param iut_laddr          Hardware address of @p iut_if
  * @param tst_laddr          Hardware address of @p tst_if
- * @param wrs_num            Number of work requests
+ * @param wrs_num            Number of work requests, @c 0 means to fill
+ *                           send and receive queues up to the depth
+ *                           supported by both devices
  * @param sge_num            Lenght of SGE list
  * @param set_sq_sig_all     If it is @c TRUE set @p sq_sig_all to @c 1
  *                           for QP
@@ -25,6 +27,9 @@
  *                           send WRs
  * @param set_ip_csum        If it is @c TRUE set @c IBV_SEND_IP_CSUM in
  *                           send WRs
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
  *
  * @author Yurij Plotnikov <Yurij.Plotnikov@oktetlabs.ru>
  *
@@ -34,12 +39,14 @@
 #define TE_TEST_NAME  "usecases/many_wrs"
 
 #include "ibvapi-test.h"
+#include "tapi_mem.h"
 
-#define BUF_SIZE 1024
 #define SEND_LEN 256
-#define MAX_WRS_NUM 16
-#define MAX_SGE_NUM 4
 #define AUX_BUF_SIZE 20
+/** Length of sent packet */
+#define TX_LEN (sizeof(te_eth_ip_udp_hdr) + SEND_LEN)
+/** Length of space for a packet referred by receive WR */
+#define RX_LEN (TX_LEN + AUX_BUF_SIZE)
 
 static void
 gen_parts_len(int sge_num, int data_len, int *parts)
@@ -55,28 +62,11 @@ gen_parts_len(int sge_num, int data_len, int *parts)
     parts[sge_num - 1] = tmp;
 }
 
-static void
-assamble_buf(rcf_rpc_server *rpcs, struct rpc_ibv_sge *sge,
-             int sge_num, void *hdr, void *buf)
-{
-    char  tmp_buf[sizeof(te_eth_ip_udp_hdr) + SEND_LEN + AUX_BUF_SIZE];
-    char *ptr = tmp_buf;
-    int   i;
-    memset(tmp_buf, 0, sizeof(tmp_buf));
-
-    for (i = 0; i < sge_num; i++)
-    {
-        rpc_get_buf_gen(rpcs, sge[i].addr, 0, sge[i].length,
-                        (uint8_t *)ptr);
-        ptr += sge[i].length;
-    }
-    memcpy(hdr, tmp_buf, sizeof(te_eth_ip_udp_hdr));
-    memcpy(buf, &tmp_buf[sizeof(te_eth_ip_udp_hdr)], SEND_LEN);
-}
 int
 main(int argc, char *argv[])
 {
     rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
     rcf_rpc_server     *pco_tst = NULL;
 
     struct rpc_ibv_context *iut_context = NULL;
@@ -86,7 +76,7 @@ main(int argc, char *argv[])
 
     rpc_ptr                      iut_pd = RPC_NULL;
 
-    struct rpc_ibv_mr           *iut_mr[MAX_WRS_NUM][MAX_SGE_NUM];
+    ibvts_buf_pool               iut_pool;
     struct rpc_ibv_comp_channel *iut_ev_ch = NULL;
 
     rpc_ptr                 iut_scq = RPC_NULL;
@@ -96,7 +86,7 @@ main(int argc, char *argv[])
 
     rpc_ptr                 tst_pd = RPC_NULL;
 
-    struct rpc_ibv_mr           *tst_mr[MAX_WRS_NUM][MAX_SGE_NUM];
+    ibvts_buf_pool               tst_pool;
 
     rpc_ptr                 tst_scq = RPC_NULL;
     rpc_ptr                 tst_rcq = RPC_NULL;
@@ -113,13 +103,14 @@ main(int argc, char *argv[])
     const struct sockaddr  *mcast_addr = NULL;
 
     struct rpc_ibv_device_attr attr;
+    int                        iut_pool_size = 0;
+    int                        tst_pool_size = 0;
 
-    rpc_ptr                 iut_buffers[MAX_WRS_NUM][MAX_SGE_NUM];
-    rpc_ptr                 tst_buffers[MAX_WRS_NUM][MAX_SGE_NUM];
-    void                   *tx_buf[MAX_WRS_NUM];
-    void                   *rx_buf;
+    uint8_t                *payload = NULL;
+    char                  **tx_buf = NULL;
+    rpc_ptr                 exp_buf = RPC_NULL;
 
-    uint8_t                 packet[BUF_SIZE];
+    uint8_t                *packets = NULL;
     int                     pkt_len;
 
     int                     wrs_num;
@@ -127,19 +118,20 @@ main(int argc, char *argv[])
 
     union rpc_ibv_gid       mgid;
 
-    struct rpc_ibv_sge      recv_sge[MAX_WRS_NUM][MAX_SGE_NUM];
-    struct rpc_ibv_sge      send_sge[MAX_WRS_NUM][MAX_SGE_NUM];
-    struct rpc_ibv_recv_wr  iut_wr[MAX_WRS_NUM];
+    struct rpc_ibv_sge     *recv_sge = NULL;
+    struct rpc_ibv_sge     *send_sge = NULL;
+    struct rpc_ibv_recv_wr *iut_wr = NULL;
     struct rpc_ibv_recv_wr *iut_bad_wr = NULL;
-    struct rpc_ibv_send_wr  tst_wr[MAX_WRS_NUM];
+    struct rpc_ibv_send_wr *tst_wr = NULL;
     struct rpc_ibv_send_wr *tst_bad_wr = NULL;
-    struct rpc_ibv_wc       wc[MAX_WRS_NUM];
-    int                     parts[MAX_SGE_NUM];
+    struct rpc_ibv_wc      *wc = NULL;
+    int                    *parts = NULL;
 
     struct rpc_pollfd       fds;
 
     int i;
     int j;
+    size_t off;
     int send_cnt = 0;
 
     te_bool                 set_signaled;
@@ -147,12 +139,14 @@ main(int argc, char *argv[])
     te_bool                 set_send_inline;
 
     te_eth_ip_udp_hdr    check_pack;
+    struct iphdr         iphdr;
 
-    uint16_t             csum;
-    te_bool              correct_csum[MAX_WRS_NUM];
+    te_bool             *correct_csum = NULL;
     te_bool              set_ip_csum = FALSE;
+    ibvts_buf_backing    buf_backing;
 
-    int                  total_len;
+    uint64_t             compl_time;
+    ssize_t              mismatch;
 
     TEST_START;
     TEST_GET_IBV_PCO(pco_tst);
@@ -167,34 +161,13 @@ main(int argc, char *argv[])
     TEST_GET_BOOL_PARAM(set_signaled);
     TEST_GET_BOOL_PARAM(set_send_inline);
     TEST_GET_BOOL_PARAM(set_ip_csum);
-
-    TEST_STEP("Create @p wrs_num * @p sge_num number of buffers on "
-              "@p pco_iut and @p pco_tst.");
-    for (i = 0; i < wrs_num; i++)
-    {
-        tx_buf[i] = te_make_buf_by_len(SEND_LEN);
-        te_fill_buf(tx_buf[i], SEND_LEN);
-    }
-    rx_buf = te_make_buf_by_len(SEND_LEN);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
 
     memset(&attr, 0, sizeof(attr));
     memset(&qp_attr, 0, sizeof(qp_attr));
     memset(&mod_attr, 0, sizeof(mod_attr));
-    memset(&iut_wr, 0, sizeof(iut_wr));
-    memset(&tst_wr, 0, sizeof(tst_wr));
-    memset(recv_sge, 0, sizeof(recv_sge));
-    memset(send_sge, 0, sizeof(send_sge));
-    memset(wc, 0, sizeof(wc));
-    memset(iut_mr, 0, sizeof(iut_mr));
-
-    for (i = 0; i < wrs_num; i++)
-        for (j = 0; j < sge_num; j++)
-        {
-            iut_buffers[i][j] = rpc_memalign(pco_iut, TEST_PAGE_SIZE,
-                                             BUF_SIZE);
-            tst_buffers[i][j] = rpc_memalign(pco_tst, TEST_PAGE_SIZE,
-                                             BUF_SIZE);
-        }
+    memset(&iut_pool, 0, sizeof(iut_pool));
+    memset(&tst_pool, 0, sizeof(tst_pool));
 
     TEST_STEP("Call @b ibv_open_device() to create device context "
               "on @p pco_iut.");
@@ -204,23 +177,62 @@ main(int argc, char *argv[])
               "on @p pco_iut.");
     iut_pd = rpc_ibv_alloc_pd(pco_iut, iut_context->context);
 
-    TEST_STEP("Create @p wrs_num * @p sge_num number of memory regions using "
-              "to allocated buffers on @p pco_iut.");
-    for (i = 0; i < wrs_num; i++)
-        for (j = 0; j < sge_num; j++)
-            iut_mr[i][j] = rpc_ibv_reg_mr(pco_iut, iut_pd,
-                                          iut_buffers[i][j],
-                                          BUF_SIZE,
-                                          IBV_ACCESS_REMOTE_WRITE |
-                                          IBV_ACCESS_LOCAL_WRITE |
-                                          IBV_ACCESS_REMOTE_READ);
-
     TEST_STEP("Call @b ibv_query_device() to get device attributes "
               "on @p pco_iut.");
     rpc_ibv_query_device(pco_iut, iut_context->context, &attr);
 
-    pool_size = attr.max_cqe < attr.max_qp_wr ? attr.max_cqe :
-                                                attr.max_qp_wr;
+    iut_pool_size = attr.max_cqe < attr.max_qp_wr ? attr.max_cqe :
+                                                    attr.max_qp_wr;
+
+    TEST_STEP("Call @b ibv_open_device() to create device context "
+              "on @p pco_tst.");
+    tst_context = rpc_ibv_open_device(pco_tst, &tst_ibv_port);
+
+    TEST_STEP("Call @b ibv_alloc_pd() to create protection domain "
+              "on @p pco_tst.");
+    tst_pd = rpc_ibv_alloc_pd(pco_tst, tst_context->context);
+
+    TEST_STEP("Call @b ibv_query_device() to get device attributes "
+              "on @p pco_tst.");
+    memset(&attr, 0, sizeof(attr));
+    rpc_ibv_query_device(pco_tst, tst_context->context, &attr);
+
+    tst_pool_size = attr.max_cqe < attr.max_qp_wr ? attr.max_cqe :
+                                                    attr.max_qp_wr;
+
+    TEST_STEP("If @p wrs_num is @c 0, set it to the minimum of queue "
+              "depths supported by devices on @p pco_iut and @p pco_tst.");
+    if (wrs_num == 0)
+    {
+        wrs_num = MIN(iut_pool_size, tst_pool_size);
+        RING("Queues are filled up to %d WRs", wrs_num);
+    }
+    else if (wrs_num > iut_pool_size || wrs_num > tst_pool_size)
+    {
+        TEST_FAIL("'wrs_num' exceeds the queue size supported by device");
+    }
+
+    payload = te_make_buf_by_len(wrs_num * SEND_LEN);
+    te_fill_buf(payload, wrs_num * SEND_LEN);
+    tx_buf = tapi_calloc(wrs_num, sizeof(*tx_buf));
+    for (i = 0; i < wrs_num; i++)
+        tx_buf[i] = (char *)&payload[i * SEND_LEN];
+    packets = tapi_calloc(wrs_num, sizeof(te_eth_ip_udp_hdr) + SEND_LEN);
+    recv_sge = tapi_calloc(wrs_num * sge_num, sizeof(*recv_sge));
+    send_sge = tapi_calloc(wrs_num * sge_num, sizeof(*send_sge));
+    iut_wr = tapi_calloc(wrs_num, sizeof(*iut_wr));
+    tst_wr = tapi_calloc(wrs_num, sizeof(*tst_wr));
+    wc = tapi_calloc(wrs_num, sizeof(*wc));
+    parts = tapi_calloc(sge_num, sizeof(*parts));
+    correct_csum = tapi_calloc(wrs_num, sizeof(*correct_csum));
+
+    TEST_STEP("Create @p wrs_num buffers placed without gaps in one "
+              "memory region on @p pco_iut, one buffer per receive WR.");
+    ibvts_buf_pool_create(pco_iut, iut_pd, wrs_num, 1, RX_LEN,
+                          IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_LOCAL_WRITE |
+                          IBV_ACCESS_REMOTE_READ, &iut_pool);
+
+    pool_size = iut_pool_size;
 
     TEST_STEP("Call @b ibv_create_comp_channel() to create completion "
               "channel @p iut_ev_ch on @p pco_iut.");
@@ -261,32 +273,13 @@ main(int argc, char *argv[])
     mod_attr.qp_state = IBV_QPS_RTS;
     rpc_ibv_modify_qp(pco_iut, iut_qp->qp, &mod_attr, IBV_QP_STATE);
 
-    TEST_STEP("Call @b ibv_open_device() to create device context "
-              "on @p pco_tst.");
-    tst_context = rpc_ibv_open_device(pco_tst, &tst_ibv_port);
-
-    TEST_STEP("Call @b ibv_alloc_pd() to create protection domain "
-              "on @p pco_tst.");
-    tst_pd = rpc_ibv_alloc_pd(pco_tst, tst_context->context);
-
-    TEST_STEP("Create @p wrs_num * @p sge_num number of memory regions using "
-              "to allocated buffers on @p pco_tst.");
-    for (i = 0; i < wrs_num; i++)
-        for (j = 0; j < sge_num; j++)
-            tst_mr[i][j] = rpc_ibv_reg_mr(pco_tst, tst_pd,
-                                          tst_buffers[i][j],
-                                          BUF_SIZE,
-                                          IBV_ACCESS_REMOTE_WRITE |
-                                          IBV_ACCESS_LOCAL_WRITE |
-                                          IBV_ACCESS_REMOTE_READ);
-
-    TEST_STEP("Call @b ibv_query_device() to get device attributes "
-              "on @p pco_tst.");
-    memset(&attr, 0, sizeof(attr));
-    rpc_ibv_query_device(pco_tst, tst_context->context, &attr);
+    TEST_STEP("Create @p wrs_num buffers placed without gaps in one "
+              "memory region on @p pco_tst, one buffer per send WR.");
+    ibvts_buf_pool_create(pco_tst, tst_pd, wrs_num, 1, TX_LEN,
+                          IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_LOCAL_WRITE |
+                          IBV_ACCESS_REMOTE_READ, &tst_pool);
 
-    pool_size = attr.max_cqe < attr.max_qp_wr ? attr.max_cqe :
-                                                attr.max_qp_wr;
+    pool_size = tst_pool_size;
 
     TEST_STEP("Call @b ibv_create_cq() to create receive completion queue "
               "@p tst_rcq.");
@@ -344,19 +337,19 @@ main(int argc, char *argv[])
             iut_wr[i].next = NULL;
         else
             iut_wr[i].next = &iut_wr[i + 1];
-        iut_wr[i].sg_list = recv_sge[i];
+        iut_wr[i].sg_list = &recv_sge[i * sge_num];
         iut_wr[i].num_sge = sge_num;
 
-        memset(parts, 0, sizeof(parts));
-        gen_parts_len(sge_num, sizeof(te_eth_ip_udp_hdr) +
-                               SEND_LEN + AUX_BUF_SIZE, parts);
+        memset(parts, 0, sge_num * sizeof(*parts));
+        gen_parts_len(sge_num, RX_LEN, parts);
+        off = iut_pool.stride * i;
         for (j = 0; j < sge_num; j++)
         {
-            recv_sge[i][j].length = parts[j];
-            recv_sge[i][j].lkey = iut_mr[i][j]->lkey;
-            recv_sge[i][j].addr = iut_buffers[i][j];
+            ibvts_buf_pool_sge_at(&iut_pool, off, parts[j],
+                                  &recv_sge[i * sge_num + j]);
+            off += parts[j];
         }
-        iut_wr[i].wr_id = recv_sge[i][0].addr;
+        iut_wr[i].wr_id = i;
     }
 
     rpc_ibv_post_recv(pco_iut, iut_qp->qp, iut_wr, &iut_bad_wr);
@@ -379,8 +372,12 @@ main(int argc, char *argv[])
         TEST_VERDICT("poll() reports unexpected event");
 
     TEST_STEP("Create @p wrs_num number of raw multicast packets and write "
-              "them to allocated buffers on @p pco_tst. Each packet would be "
-              "devided between @p sge_num buffers.");
+              "them to allocated buffers on @p pco_tst by one call. Each "
+              "packet would be devided between @p sge_num adjacent parts of "
+              "its buffer.");
+    pkt_len = ibvts_create_raw_udp_burst(tst_laddr, iut_laddr, tst_addr,
+                                         mcast_addr, 0, TRUE, tx_buf,
+                                         SEND_LEN, wrs_num, packets);
 #define IBV_SET_FLAG(_flag, _set, _act) \
     do {                                    \
         if (rand_range(0, 1) == 1 && _set)  \
@@ -397,7 +394,7 @@ main(int argc, char *argv[])
             tst_wr[i].next = NULL;
         else
             tst_wr[i].next = &tst_wr[i + 1];
-        tst_wr[i].sg_list = send_sge[i];
+        tst_wr[i].sg_list = &send_sge[i * sge_num];
         tst_wr[i].num_sge = sge_num;
         tst_wr[i].opcode = IBV_WR_SEND;
 
@@ -416,24 +413,18 @@ main(int argc, char *argv[])
                      { send_cnt++; });
         IBV_SET_FLAG(IBV_SEND_INLINE, set_send_inline, { });
 
-        pkt_len = ibvts_create_raw_udp_dgm(tst_laddr, iut_laddr, tst_addr,
-                                           mcast_addr, 0, TRUE, tx_buf[i],
-                                           SEND_LEN, packet);
         gen_parts_len(sge_num, pkt_len, parts);
-        total_len = 0;
+        off = tst_pool.stride * i;
         for (j = 0; j < sge_num; j++)
         {
-            rpc_set_buf_gen(pco_tst, &packet[total_len], parts[j],
-                            tst_buffers[i][j], 0);
-            send_sge[i][j].length = parts[j];
-            send_sge[i][j].lkey = tst_mr[i][j]->lkey;
-            send_sge[i][j].addr = tst_buffers[i][j];
-            total_len += parts[j];
+            ibvts_buf_pool_sge_at(&tst_pool, off, parts[j],
+                                  &send_sge[i * sge_num + j]);
+            off += parts[j];
         }
-        memset(packet, 0, sizeof(packet));
-        tst_wr[i].wr_id = send_sge[i][0].addr;
+        tst_wr[i].wr_id = i;
     }
 #undef IBV_SET_FLAG
+    ibvts_upload_burst(pco_tst, packets, tst_wr, wrs_num);
 
     if (set_sq_sig_all)
         send_cnt = wrs_num;
@@ -441,10 +432,14 @@ main(int argc, char *argv[])
     TEST_STEP("Call @b ibv_post_send() using allocated buffers and memory "
               "regions on @p pco_tst accoring to test parameters.");
     rpc_ibv_post_send(pco_tst, tst_qp->qp, tst_wr, &tst_bad_wr);
-    SLEEP(5);
 
-    if (rpc_ibv_poll_cq(pco_tst, tst_scq, MAX_WRS_NUM, wc) != send_cnt)
+    TEST_STEP("Call @b ibv_poll_cq() on @p tst_scq until completions of all "
+              "signaled send WRs are reported.");
+    if (ibvts_poll_cq_wait(pco_tst, tst_scq, send_cnt, TEST_COMPL_TIMEOUT,
+                           TRUE, wc, &compl_time) != send_cnt)
         TEST_VERDICT("ibv_poll_cq() on SQ returned incorrect number");
+    RING("Completions of %d send WRs were got in %llu us", send_cnt,
+         (unsigned long long)compl_time);
 
     TEST_STEP("Call @b poll() on fd of @p iut_ev_ch and check that it reports "
               "event.");
@@ -455,10 +450,13 @@ main(int argc, char *argv[])
         TEST_VERDICT("poll() doesn't report expected event");
 
     TEST_STEP("Call @b ibv_poll_cq() on @p iut_rcq and check that it reports "
-              "event.");
-    memset(wc, 0, sizeof(wc));
-    if (rpc_ibv_poll_cq(pco_iut, iut_rcq, MAX_WRS_NUM, wc) == wrs_num)
+              "events for all posted receive WRs.");
+    memset(wc, 0, wrs_num * sizeof(*wc));
+    if (ibvts_poll_cq_wait(pco_iut, iut_rcq, wrs_num, TEST_COMPL_TIMEOUT, TRUE,
+                           wc, &compl_time) == wrs_num)
     {
+        RING("Completions of %d receive WRs were got in %llu us", wrs_num,
+             (unsigned long long)compl_time);
         rpc_ibv_get_cq_event(pco_iut, iut_ev_ch->cc, &tmp_cq, NULL);
         if (tmp_cq != iut_rcq)
             TEST_VERDICT("ibv_get_cq_event() returns incorrect CQ");
@@ -467,6 +465,12 @@ main(int argc, char *argv[])
     else
         TEST_VERDICT("ibv_poll_cq() doesn't report expected events");
 
+    TEST_STEP("Write payloads of all sent packets to buffer @p exp_buf on "
+              "@p pco_iut by one call, so that received data is compared "
+              "with them on the agent.");
+    exp_buf = rpc_malloc(pco_iut, wrs_num * SEND_LEN);
+    rpc_set_buf_gen(pco_iut, payload, wrs_num * SEND_LEN, exp_buf, 0);
+
     TEST_STEP("Get events from @p iut_rcq and acknowledge it.");
     for (i = 0; i < wrs_num; i++)
     {
@@ -475,23 +479,29 @@ main(int argc, char *argv[])
             ERROR("Status of %d work request is %d", i, wc[i].status);
             TEST_VERDICT("Not all WR succeeded");
         }
-        memset(rx_buf, 0, SEND_LEN);
-        assamble_buf(pco_iut, recv_sge[i], sge_num, &check_pack, rx_buf);
-
-        TEST_STEP("Compare buffers on @p pco_tst and @p pco_iut.");
-        if (memcmp(tx_buf[i], rx_buf, SEND_LEN) != 0)
+        memset(&check_pack, 0, sizeof(check_pack));
+        ibvts_read_sge_data(pco_iut, &recv_sge[i * sge_num], sge_num, 0,
+                            sizeof(check_pack), (uint8_t *)&check_pack);
+
+        TEST_STEP("Compare received payload with the expected one in "
+                  "@p exp_buf on @p pco_iut.");
+        mismatch = ibvts_cmp_sge_data(pco_iut, &recv_sge[i * sge_num],
+                                      sge_num, sizeof(te_eth_ip_udp_hdr),
+                                      exp_buf, i * SEND_LEN, SEND_LEN);
+        if (mismatch >= 0)
+        {
+            ERROR("Payload of %d packet differs in part starting at "
+                  "offset %zd", i, mismatch);
             TEST_VERDICT("Data was corrupted during post_send() and "
                          "post_recv() opterations");
+        }
 
         TEST_STEP("Check that @c IBV_SEND_IP_CSUM, @c IBV_SEND_SIGNALED and "
                   "@c IBV_SEND_INLINE flags are handled correctly.");
         if (correct_csum[i])
         {
-            csum = ~check_pack.iphdr.check;
-            check_pack.iphdr.check = 0;
-            if (csum !=
-                calculate_checksum(&(check_pack.iphdr),
-                                   sizeof(struct iphdr)))
+            memcpy(&iphdr, &(check_pack.iphdr), sizeof(iphdr));
+            if (ibvts_ip_csum(&iphdr) != 0)
                 TEST_VERDICT("IP checksum is incorrect");
         }
         else if (check_pack.iphdr.check != 0)
@@ -499,6 +509,11 @@ main(int argc, char *argv[])
                          "IBV_SEND_IP_CSUM was not set");
     }
 
+    TEST_STEP("Call @b ibv_poll_cq() on @p tst_scq and check that it "
+              "doesn't report completions of unsignaled send WRs.");
+    if (rpc_ibv_poll_cq(pco_tst, tst_scq, wrs_num, wc) > 0)
+        TEST_VERDICT("ibv_poll_cq() on SQ returned incorrect number");
+
     TEST_STEP("Free all allocated resources.");
     rpc_ibv_detach_mcast(pco_iut, iut_qp->qp, &mgid, 0);
 
@@ -509,9 +524,7 @@ main(int argc, char *argv[])
 
     rpc_ibv_destroy_comp_channel(pco_iut, iut_ev_ch);
 
-    for (i = 0; i < wrs_num; i++)
-        for (j = 0; j < sge_num; j++)
-            rpc_ibv_dereg_mr(pco_iut, iut_mr[i][j]);
+    ibvts_buf_pool_destroy(&iut_pool);
 
     rpc_ibv_dealloc_pd(pco_iut, iut_pd);
     rpc_ibv_close_device(pco_iut, iut_context);
@@ -521,9 +534,7 @@ main(int argc, char *argv[])
     rpc_ibv_destroy_cq(pco_tst, tst_scq);
     rpc_ibv_destroy_cq(pco_tst, tst_rcq);
 
-    for (i = 0; i < wrs_num; i++)
-        for (j = 0; j < sge_num; j++)
-            rpc_ibv_dereg_mr(pco_tst, tst_mr[i][j]);
+    ibvts_buf_pool_destroy(&tst_pool);
 
     rpc_ibv_dealloc_pd(pco_tst, tst_pd);
     rpc_ibv_close_device(pco_tst, tst_context);
@@ -531,16 +542,20 @@ main(int argc, char *argv[])
     TEST_SUCCESS;
 
 cleanup:
-    free(rx_buf);
-    for (i = 0; i < wrs_num; i++)
-    {
-        free(tx_buf[i]);
-        for (j = 0; j < sge_num; j++)
-        {
-            rpc_free(pco_iut, iut_buffers[i][j]);
-            rpc_free(pco_tst, tst_buffers[i][j]);
-        }
-    }
+    free(payload);
+    free(tx_buf);
+    rpc_free(pco_iut, exp_buf);
+    free(packets);
+    free(recv_sge);
+    free(send_sge);
+    free(iut_wr);
+    free(tst_wr);
+    free(wc);
+    free(parts);
+    free(correct_csum);
+    ibvts_buf_pool_destroy(&iut_pool);
+    ibvts_buf_pool_destroy(&tst_pool);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
 
     TEST_END;
 }
@@ -17,6 +17,9 @@
  * @param tst_laddr          Hardware address of @p tst_if
  * @param local_write_access Set or don't set IBV_ACCESS_LOCAL_WRITE on IUT
  *                           memory region
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
  *
  * @author Yurij Plotnikov <Yurij.Plotnikov@oktetlabs.ru>
  *
@@ -34,6 +37,7 @@ int
 main(int argc, char *argv[])
 {
     rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
     rcf_rpc_server     *pco_tst = NULL;
 
     int                     tst_s = -1;
@@ -100,6 +104,7 @@ main(int argc, char *argv[])
     struct rpc_pollfd       fds;
 
     te_bool                 local_write_access;
+    ibvts_buf_backing       buf_backing;
 
     TEST_START;
     TEST_GET_IBV_PCO(pco_tst);
@@ -109,6 +114,7 @@ main(int argc, char *argv[])
     TEST_GET_LINK_ADDR(iut_laddr);
     TEST_GET_LINK_ADDR(tst_laddr);
     TEST_GET_BOOL_PARAM(local_write_access);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
 
     TEST_STEP("Create two buffers @p iut_buffer and @p tst_buffer "
               "on @p pco_iut and @p pco_tst.");
@@ -453,6 +459,7 @@ cleanup:
     rpc_free(pco_tst, tst_buffer);
 
     CLEANUP_RPC_CLOSE(pco_tst, tst_s);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
 
     TEST_END;
 }
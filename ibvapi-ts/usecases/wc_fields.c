@@ -21,6 +21,9 @@
  * @param send_first         If it is @c TRUE call @b ibv_post_send()
  *                           before @b ibv_post_recv()
  * @param comp_wr            Describes which WR should be posted
+ * @param buf_backing        Pages backing buffers on IUT: @c 4k,
+ *                           @c thp, @c huge_2m or @c huge_1g (see
+ *                           ibvts_buf_backing_fork())
  *
  * @author Yurij Plotnikov <Yurij.Plotnikov@oktetlabs.ru>
  *
@@ -39,6 +42,7 @@ int
 main(int argc, char *argv[])
 {
     rcf_rpc_server     *pco_iut = NULL;
+    rcf_rpc_server     *pco_iut_orig = NULL;
     rcf_rpc_server     *pco_tst = NULL;
 
     struct rpc_ibv_context *iut_context = NULL;
@@ -101,6 +105,7 @@ main(int argc, char *argv[])
     te_bool                 two_cq;
     te_bool                 send_first;
     const char             *comp_wr;
+    ibvts_buf_backing       buf_backing;
 
     te_bool                 is_send[2];
 
@@ -125,6 +130,7 @@ main(int argc, char *argv[])
     TEST_GET_BOOL_PARAM(two_cq);
     TEST_GET_BOOL_PARAM(send_first);
     TEST_GET_STRING_PARAM(comp_wr);
+    TEST_GET_BUF_BACKING_PCO(pco_iut, buf_backing, pco_iut_orig);
 
     TEST_STEP("Create two buffers @p iut_recv_buffer and @p iut_send_buffer "
               "on @p pco_iut.");
@@ -385,9 +391,13 @@ main(int argc, char *argv[])
         rpc_ibv_post_send(pco_tst, tst_qp->qp, &tst_wr, &tst_bad_wr);
     }
 
-    TEST_STEP("Call @b poll_cq() and check that it returns correct number of  "
+    TEST_STEP("Call @b poll_cq() until completions of all posted WRs are "
+              "reported and check that it returns correct number of "
               "completed WRs.");
-    rc = rpc_ibv_poll_cq(pco_iut, iut_cq, MAX_WC_NUM, wc);
+    rc = ibvts_poll_cq_wait(pco_iut, iut_cq,
+                            (strcmp(comp_wr, "both") == 0) ? 2 : 1,
+                            TEST_COMPL_TIMEOUT, TRUE, wc, NULL);
+    rc += rpc_ibv_poll_cq(pco_iut, iut_cq, MAX_WC_NUM - rc, wc + rc);
 
     if (!((rc == 1 && strcmp(comp_wr, "both") != 0) ||
           (rc == 2 && strcmp(comp_wr, "both") == 0)) )
@@ -466,6 +476,7 @@ cleanup:
     rpc_free(pco_iut, iut_send_buffer);
     rpc_free(pco_iut, iut_recv_buffer);
     rpc_free(pco_tst, tst_buffer);
+    CLEANUP_BUF_BACKING_PCO(pco_iut, pco_iut_orig);
 
     TEST_END;
 }